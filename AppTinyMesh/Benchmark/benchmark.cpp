@@ -0,0 +1,907 @@
+// Benchmark
+
+#include "camera.h"
+#include "distancegrid.h"
+#include "implicits.h"
+#include "meshbvh.h"
+#include "meshcolor.h"
+#include "meshcompressed.h"
+#include "meshdistance.h"
+#include "meshf.h"
+#include "meshstatistics.h"
+#include "renderer.h"
+#include "topology.h"
+
+#include <QtCore/qstring.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+\brief Blend of spherical primitives, used as a synthetic benchmark field.
+
+The field is a sum of Wyvill falloff functions centered at pseudo-random
+locations, all generated from a fixed seed so that every run polygonizes
+exactly the same surface.
+*/
+class Blob : public AnalyticScalarField
+{
+protected:
+  std::vector<Vector> centers; //!< Centers of the primitives.
+  double radius;               //!< Radius of influence.
+public:
+  explicit Blob(int, double, unsigned int = 1);
+  double Value(const Vector&) const override;
+};
+
+/*!
+\brief Create a blob field.
+\param n Number of primitives.
+\param r Radius of influence.
+\param seed Random seed for the centers.
+*/
+Blob::Blob(int n, double r, unsigned int seed) :radius(r)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  centers.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    centers[i] = Vector(uniform(rng), uniform(rng), uniform(rng));
+  }
+}
+
+/*!
+\brief Compute the value of the field, negative inside.
+\param p Point.
+*/
+double Blob::Value(const Vector& p) const
+{
+  double f = 0.0;
+  for (int i = 0; i < centers.size(); i++)
+  {
+    double x = SquaredNorm(p - centers[i]) / (radius * radius);
+    if (x < 1.0)
+    {
+      double y = 1.0 - x;
+      f += y * y * y;
+    }
+  }
+  return 0.5 - f;
+}
+
+/*!
+\brief Timing record for one benchmark case run with a given thread count.
+*/
+class BenchmarkResult
+{
+public:
+  std::string name;   //!< Case name, stable across runs.
+  int threads = 1;    //!< Number of threads.
+  long long size = 0; //!< Problem size (triangles, vertices or rays).
+  int repetitions = 0;//!< Number of timed repetitions.
+  double min = 0.0;   //!< Minimum time, in milliseconds.
+  double median = 0.0;//!< Median time, in milliseconds.
+};
+
+/*!
+\brief Benchmark case: a named, timed function, its untimed setup and its problem size.
+*/
+class BenchmarkCase
+{
+public:
+  std::string name;              //!< Case name.
+  std::function<long long()> setup; //!< Untimed setup, returns the problem size.
+  std::function<void()> run;     //!< Timed kernel.
+};
+
+/*!
+\brief Benchmark driver for the geometry core.
+
+Every input is synthetic and generated from fixed seeds: implicit sphere and blob
+fields polygonized at several resolutions, and .obj files written to a scratch
+directory from those meshes. Each case is timed for every requested thread count
+and the results may be written as JSON and compared against a saved baseline.
+*/
+class Benchmark
+{
+protected:
+  std::vector<BenchmarkCase> cases;     //!< Registered cases.
+  std::vector<BenchmarkResult> results; //!< Results.
+  int repetitions = 5;                  //!< Number of timed repetitions per case.
+  int failures = 0;                     //!< Number of cases whose setup failed.
+public:
+  explicit Benchmark(int r) :repetitions(r) {}
+
+  void Add(const std::string&, const std::function<long long()>&, const std::function<void()>&);
+  void Run(const std::vector<int>&, const std::string&);
+
+  void SaveJson(const std::string&) const;
+  static std::vector<BenchmarkResult> LoadJson(const std::string&);
+  int Compare(const std::vector<BenchmarkResult>&, double) const;
+
+  //! Get the number of cases whose setup failed.
+  int Failures() const { return failures; }
+};
+
+/*!
+\brief Register a case.
+\param name Name.
+\param setup Untimed setup function, returning the problem size, or a negative value if the inputs are invalid.
+\param run Timed function.
+*/
+void Benchmark::Add(const std::string& name, const std::function<long long()>& setup, const std::function<void()>& run)
+{
+  cases.push_back({ name, setup, run });
+}
+
+/*!
+\brief Run all the cases whose name contains a filter string.
+
+Cases whose setup fails are reported and skipped, and counted in Benchmark::Failures().
+\param threads Thread counts.
+\param filter Filter, empty string runs every case.
+*/
+void Benchmark::Run(const std::vector<int>& threads, const std::string& filter)
+{
+  for (const BenchmarkCase& c : cases)
+  {
+    if (!filter.empty() && c.name.find(filter) == std::string::npos)
+      continue;
+
+    long long size = c.setup();
+    if (size < 0)
+    {
+      std::printf("%-32s FAILED\n", c.name.c_str());
+      std::fflush(stdout);
+      failures++;
+      continue;
+    }
+    for (int t : threads)
+    {
+#ifdef _OPENMP
+      omp_set_num_threads(t);
+#endif
+      // Warm up
+      c.run();
+
+      std::vector<double> times(repetitions);
+      for (int i = 0; i < repetitions; i++)
+      {
+        auto start = std::chrono::steady_clock::now();
+        c.run();
+        times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      }
+      std::sort(times.begin(), times.end());
+
+      BenchmarkResult r;
+      r.name = c.name;
+      r.threads = t;
+      r.size = size;
+      r.repetitions = repetitions;
+      r.min = times.front();
+      r.median = times[repetitions / 2];
+      results.push_back(r);
+
+      std::printf("%-32s threads %3d  size %10lld  min %10.3f ms  median %10.3f ms\n", r.name.c_str(), t, size, r.min, r.median);
+      std::fflush(stdout);
+    }
+  }
+}
+
+/*!
+\brief Save the results in JSON format, one result object per line.
+\param filename File name.
+*/
+void Benchmark::SaveJson(const std::string& filename) const
+{
+  std::ofstream out(filename);
+  out << "{\n";
+  out << "  \"benchmark\": \"AppTinyMesh\",\n";
+  out << "  \"repetitions\": " << repetitions << ",\n";
+  out << "  \"results\": [\n";
+  for (int i = 0; i < results.size(); i++)
+  {
+    const BenchmarkResult& r = results[i];
+    char line[512];
+    std::snprintf(line, sizeof(line), "    { \"name\": \"%s\", \"threads\": %d, \"size\": %lld, \"repetitions\": %d, \"min_ms\": %.6f, \"median_ms\": %.6f }%s\n",
+      r.name.c_str(), r.threads, r.size, r.repetitions, r.min, r.median, i + 1 < results.size() ? "," : "");
+    out << line;
+  }
+  out << "  ]\n";
+  out << "}\n";
+}
+
+/*!
+\brief Load results from a JSON file written by Benchmark::SaveJson().
+
+The reader only handles the flat result objects of the "results" array.
+\param filename File name.
+*/
+std::vector<BenchmarkResult> Benchmark::LoadJson(const std::string& filename)
+{
+  std::vector<BenchmarkResult> list;
+
+  std::ifstream in(filename);
+  if (!in)
+  {
+    std::fprintf(stderr, "Cannot open baseline %s\n", filename.c_str());
+    return list;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  const std::string text = buffer.str();
+
+  // Skip to the results array
+  size_t at = text.find("\"results\"");
+  if (at == std::string::npos)
+    return list;
+
+  // Value of a given key inside an object
+  auto value = [](const std::string& object, const std::string& key) -> std::string
+  {
+    size_t k = object.find("\"" + key + "\"");
+    if (k == std::string::npos)
+      return std::string();
+    k = object.find(':', k);
+    size_t s = object.find_first_not_of(" \t\n\r", k + 1);
+    if (object[s] == '"')
+    {
+      return object.substr(s + 1, object.find('"', s + 1) - s - 1);
+    }
+    size_t e = object.find_first_of(",} \t\n\r", s);
+    return object.substr(s, e - s);
+  };
+
+  while ((at = text.find('{', at)) != std::string::npos)
+  {
+    size_t end = text.find('}', at);
+    if (end == std::string::npos)
+      break;
+    const std::string object = text.substr(at, end - at + 1);
+    BenchmarkResult r;
+    r.name = value(object, "name");
+    r.threads = std::atoi(value(object, "threads").c_str());
+    r.size = std::atoll(value(object, "size").c_str());
+    r.repetitions = std::atoi(value(object, "repetitions").c_str());
+    r.min = std::atof(value(object, "min_ms").c_str());
+    r.median = std::atof(value(object, "median_ms").c_str());
+    if (!r.name.empty())
+      list.push_back(r);
+    at = end + 1;
+  }
+  return list;
+}
+
+/*!
+\brief Compare the results with a baseline, matching cases by name and thread count.
+
+Speedups are reported as baseline median over current median.
+\param baseline Baseline results.
+\param tolerance Relative slowdown above which a case is flagged as a regression.
+\return The number of regressions.
+*/
+int Benchmark::Compare(const std::vector<BenchmarkResult>& baseline, double tolerance) const
+{
+  std::map<std::pair<std::string, int>, const BenchmarkResult*> reference;
+  for (const BenchmarkResult& r : baseline)
+  {
+    reference[{ r.name, r.threads }] = &r;
+  }
+
+  int regressions = 0;
+  std::printf("\n%-32s %7s %12s %12s %8s\n", "Case", "Threads", "Baseline", "Current", "Speedup");
+  for (const BenchmarkResult& r : results)
+  {
+    auto it = reference.find({ r.name, r.threads });
+    if (it == reference.end())
+    {
+      std::printf("%-32s %7d %12s %12.3f %8s\n", r.name.c_str(), r.threads, "-", r.median, "new");
+      continue;
+    }
+    const double speedup = it->second->median / r.median;
+    const bool regression = r.median > it->second->median * (1.0 + tolerance);
+    if (regression)
+      regressions++;
+    std::printf("%-32s %7d %12.3f %12.3f %7.2fx%s\n", r.name.c_str(), r.threads, it->second->median, r.median, speedup, regression ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+/*!
+\brief Write a mesh as an .obj file with fixed point coordinates, as parsed by Mesh::Load().
+\param mesh The mesh.
+\param filename File name.
+*/
+static void WriteObj(const Mesh& mesh, const std::string& filename)
+{
+  FILE* file = std::fopen(filename.c_str(), "w");
+  if (file == nullptr)
+    return;
+  std::fprintf(file, "g benchmark\n");
+  for (int i = 0; i < mesh.Vertexes(); i++)
+  {
+    Vector p = mesh.Vertex(i);
+    std::fprintf(file, "v %.6f %.6f %.6f\n", p[0], p[1], p[2]);
+  }
+  for (int i = 0; i < mesh.Vertexes(); i++)
+  {
+    Vector n = mesh.Normal(i);
+    std::fprintf(file, "vn %.6f %.6f %.6f\n", n[0], n[1], n[2]);
+  }
+  for (int i = 0; i < mesh.Triangles(); i++)
+  {
+    int a = mesh.VertexIndex(i, 0) + 1;
+    int b = mesh.VertexIndex(i, 1) + 1;
+    int c = mesh.VertexIndex(i, 2) + 1;
+    std::fprintf(file, "f %d//%d %d//%d %d//%d\n", a, a, b, b, c, c);
+  }
+  std::fclose(file);
+}
+
+/*!
+\brief Parse a comma separated list of integers.
+\param s String.
+*/
+static std::vector<int> ParseList(const std::string& s)
+{
+  std::vector<int> list;
+  std::stringstream stream(s);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    int x = std::atoi(item.c_str());
+    if (x > 0)
+      list.push_back(x);
+  }
+  return list;
+}
+
+static void Usage()
+{
+  std::printf(
+    "AppTinyMeshBenchmark [options]\n"
+    "  --threads 1,2,4     Thread counts (default: powers of two up to the number of cores)\n"
+    "  --sizes 32,64,128   Polygonization resolutions (default: 32,64,128)\n"
+    "  --repetitions n     Timed repetitions per case (default: 5)\n"
+    "  --filter string     Only run cases whose name contains the string\n"
+    "  --output file.json  Write results as JSON\n"
+    "  --compare file.json Compare with a baseline written by --output\n"
+    "  --tolerance x       Relative slowdown flagged as a regression (default: 0.1)\n"
+    "  --scratch dir       Directory for the generated .obj files (default: temporary directory)\n");
+}
+
+int main(int argc, char* argv[])
+{
+  std::vector<int> threads;
+  std::vector<int> sizes = { 32, 64, 128 };
+  int repetitions = 5;
+  std::string filter, output, baseline, scratch = std::filesystem::temp_directory_path().string();
+  double tolerance = 0.1;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg = argv[i];
+    const bool next = i + 1 < argc;
+    if (arg == "--threads" && next) threads = ParseList(argv[++i]);
+    else if (arg == "--sizes" && next) sizes = ParseList(argv[++i]);
+    else if (arg == "--repetitions" && next) repetitions = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--filter" && next) filter = argv[++i];
+    else if (arg == "--output" && next) output = argv[++i];
+    else if (arg == "--compare" && next) baseline = argv[++i];
+    else if (arg == "--tolerance" && next) tolerance = std::atof(argv[++i]);
+    else if (arg == "--scratch" && next) scratch = argv[++i];
+    else
+    {
+      Usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (threads.empty())
+  {
+    int n = 1;
+#ifdef _OPENMP
+    n = omp_get_max_threads();
+#endif
+    for (int t = 1; t < n; t *= 2)
+      threads.push_back(t);
+    threads.push_back(n);
+  }
+
+  Benchmark benchmark(repetitions);
+
+  // Shared inputs, generated lazily by the setup functions
+  const AnalyticScalarField sphere;
+  const Blob blob(16, 0.6);
+  std::map<int, Mesh> meshes;
+  std::map<int, Mesh> soups;
+  std::map<int, Mesh> sorted;
+  std::map<int, Mesh> shuffled;
+  std::map<std::string, Mesh> copies; // Private copies of the inputs modified by the timed functions, by case name
+  std::map<int, MeshCompressed> compressed;
+  std::map<int, MeshBVH> hierarchies;
+  std::vector<Ray> cameras;
+  std::vector<std::string> scratchfiles;
+  std::map<int, Renderer> renderers;
+  std::map<int, MeshDistance> distances;
+  std::vector<Vector> shell;
+  std::map<int, std::vector<Box>> boxes;
+  std::map<int, std::vector<BoxBlock>> blocks;
+  auto polygonized = [&](int n) -> Mesh&
+  {
+    auto it = meshes.find(n);
+    if (it == meshes.end())
+    {
+      Mesh mesh;
+      sphere.Polygonize(n, mesh, Box(2.0));
+      it = meshes.emplace(n, mesh).first;
+    }
+    return it->second;
+  };
+  auto shuffle = [&](int n) -> Mesh&
+  {
+    auto it = shuffled.find(n);
+    if (it == shuffled.end())
+    {
+      // Random order of the vertices and the triangles
+      const Mesh& mesh = polygonized(n);
+      std::mt19937 rng(11);
+      std::vector<int> vertexes(mesh.Vertexes());
+      std::vector<int> triangles(mesh.Triangles());
+      for (int i = 0; i < int(vertexes.size()); i++)
+      {
+        vertexes[i] = i;
+      }
+      for (int i = 0; i < int(triangles.size()); i++)
+      {
+        triangles[i] = i;
+      }
+      std::shuffle(vertexes.begin(), vertexes.end(), rng);
+      std::shuffle(triangles.begin(), triangles.end(), rng);
+
+      std::vector<Vector> vertices(vertexes.size());
+      for (int i = 0; i < int(vertexes.size()); i++)
+      {
+        vertices[vertexes[i]] = mesh.Vertex(i);
+      }
+      std::vector<int> indexes(3 * triangles.size());
+      for (int i = 0; i < int(triangles.size()); i++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          indexes[i * 3 + j] = vertexes[mesh.VertexIndex(triangles[i], j)];
+        }
+      }
+      it = shuffled.emplace(n, Mesh(std::move(vertices), std::move(indexes))).first;
+    }
+    return it->second;
+  };
+
+  auto triangleboxes = [&](int n) -> std::vector<Box>&
+  {
+    auto it = boxes.find(n);
+    if (it == boxes.end())
+    {
+      const Mesh& mesh = polygonized(n);
+      std::vector<Box> b(mesh.Triangles());
+      for (int i = 0; i < mesh.Triangles(); i++)
+      {
+        b[i] = mesh.GetTriangle(i).GetBox();
+      }
+      it = boxes.emplace(n, std::move(b)).first;
+    }
+    return it->second;
+  };
+
+  for (int n : sizes)
+  {
+    const std::string suffix = "/" + std::to_string(n);
+
+    benchmark.Add("Polygonize/Sphere" + suffix,
+      [&, n]() { return (long long)polygonized(n).Triangles(); },
+      [&, n]() { Mesh mesh; sphere.Polygonize(n, mesh, Box(2.0)); });
+
+    benchmark.Add("Polygonize/Blob" + suffix,
+      [&, n]() { Mesh mesh; blob.Polygonize(n, mesh, Box(2.0)); return (long long)mesh.Triangles(); },
+      [&, n]() { Mesh mesh; blob.Polygonize(n, mesh, Box(2.0)); });
+
+    // Sphere tracing of the camera rays of an image of nxn pixels
+    benchmark.Add("AnalyticScalarField/Intersect" + suffix,
+      [n]() { return (long long)(n) * n; },
+      [&, n]()
+      {
+        const Camera view(Vector(-3.0, -2.0, 1.5), Vector::Null, Vector::Z);
+        std::vector<Ray> rays(size_t(n) * n);
+        for (int y = 0; y < n; y++)
+          for (int x = 0; x < n; x++)
+            rays[size_t(y) * n + x] = view.PixelToRay(x, y, n, n);
+        std::vector<double> t;
+        volatile int x = sphere.Intersect(rays, t, 10.0); (void)x;
+      });
+
+    const std::string obj = scratch + "/benchmark-" + std::to_string(n) + ".obj";
+    scratchfiles.push_back(obj);
+    benchmark.Add("Mesh/Load" + suffix,
+      [&, n, obj]() { WriteObj(polygonized(n), obj); return (long long)polygonized(n).Triangles(); },
+      [obj]() { Mesh mesh; mesh.Load(QString(obj.c_str())); });
+
+    benchmark.Add("Mesh/SmoothNormals" + suffix,
+      [&, n, suffix]() { copies["Mesh/SmoothNormals" + suffix] = polygonized(n); return (long long)polygonized(n).Triangles(); },
+      [&, suffix]() { copies["Mesh/SmoothNormals" + suffix].SmoothNormals(); });
+
+    benchmark.Add("Mesh/Topology" + suffix,
+      [&, n]() { return (long long)polygonized(n).Triangles(); },
+      [&, n]() { MeshTopology topology(polygonized(n).VertexIndexes(), polygonized(n).Vertexes()); });
+
+    // Welding a triangle soup with three vertices per triangle, timing includes the copy of the soup
+    benchmark.Add("Mesh/Weld" + suffix,
+      [&, n]()
+      {
+        const Mesh& mesh = polygonized(n);
+        std::vector<Vector> vertices(3 * mesh.Triangles());
+        std::vector<int> indexes(3 * mesh.Triangles());
+        for (int i = 0; i < int(indexes.size()); i++)
+        {
+          vertices[i] = mesh.Vertex(i / 3, i % 3);
+          indexes[i] = i;
+        }
+        soups[n] = Mesh(std::move(vertices), std::move(indexes));
+        return (long long)soups[n].Vertexes();
+      },
+      [&, n]() { Mesh mesh = soups[n]; mesh.Weld(1e-6); });
+
+    // Decimation to a tenth of the triangles, timing includes the copy of the mesh
+    benchmark.Add("Mesh/Decimate" + suffix,
+      [&, n]() { return (long long)polygonized(n).Triangles(); },
+      [&, n]() { Mesh mesh = polygonized(n); mesh.Decimate(mesh.Triangles() / 10, -1.0, true); });
+
+    // Vertex cache ordering, the setup reports the average cache miss ratio before and after
+    benchmark.Add("Mesh/OptimizeCache" + suffix,
+      [&, n]()
+      {
+        Mesh mesh = polygonized(n);
+        const double before = mesh.CacheMissRatio();
+        mesh.OptimizeCache();
+        std::printf("%-32s ACMR %.3f -> %.3f\n", ("Mesh/OptimizeCache/" + std::to_string(n)).c_str(), before, mesh.CacheMissRatio());
+        return (long long)mesh.Triangles();
+      },
+      [&, n]() { Mesh mesh = polygonized(n); mesh.OptimizeCache(); });
+
+    // Space-filling curve sort of a shuffled mesh, and its effect on a gather over the one-rings
+    benchmark.Add("Mesh/SpatialSort" + suffix,
+      [&, n]() { return (long long)shuffle(n).Vertexes(); },
+      [&, n]() { Mesh mesh = shuffle(n); mesh.SpatialSort(true); });
+
+    benchmark.Add("Mesh/SmoothNormals/Shuffled" + suffix,
+      [&, n, suffix]() { copies["Mesh/SmoothNormals/Shuffled" + suffix] = shuffle(n); return (long long)shuffle(n).Triangles(); },
+      [&, suffix]() { copies["Mesh/SmoothNormals/Shuffled" + suffix].SmoothNormals(); });
+
+    benchmark.Add("Mesh/SmoothNormals/Sorted" + suffix,
+      [&, n]()
+      {
+        sorted[n] = shuffle(n);
+        sorted[n].SpatialSort(true);
+        return (long long)sorted[n].Triangles();
+      },
+      [&, n]() { sorted[n].SmoothNormals(); });
+
+    benchmark.Add("Mesh/Subdivide" + suffix,
+      [&, n]() { return 4ll * polygonized(n).Triangles(); },
+      [&, n]() { Mesh mesh = polygonized(n); mesh.Subdivide(1); });
+
+    benchmark.Add("Mesh/Taubin" + suffix,
+      [&, n]() { return 10ll * polygonized(n).Vertexes(); },
+      [&, n]() { Mesh mesh = polygonized(n); mesh.Taubin(5); });
+
+    benchmark.Add("MeshF/Convert" + suffix,
+      [&, n]() { return (long long)polygonized(n).Vertexes(); },
+      [&, n]() { MeshF mesh(polygonized(n)); volatile int x = mesh.Vertexes(); (void)x; });
+
+    benchmark.Add("MeshCompressed/Encode" + suffix,
+      [&, n]() { return (long long)polygonized(n).Vertexes(); },
+      [&, n]() { MeshCompressed mesh(polygonized(n)); volatile int x = mesh.Vertexes(); (void)x; });
+
+    benchmark.Add("MeshCompressed/Decode" + suffix,
+      [&, n]() { compressed[n] = MeshCompressed(polygonized(n)); return (long long)compressed[n].Vertexes(); },
+      [&, n]() { Mesh mesh = compressed[n].ToMesh(); volatile int x = mesh.Vertexes(); (void)x; });
+
+    benchmark.Add("Mesh/Statistics" + suffix,
+      [&, n]() { return (long long)polygonized(n).Triangles(); },
+      [&, n]() { MeshStatistics statistics(polygonized(n)); volatile double x = statistics.Area(); (void)x; });
+
+    // Transformed back and forth, the shared mesh is left unchanged as a private copy is transformed
+    benchmark.Add("Mesh/Transform" + suffix,
+      [&, n, suffix]() { copies["Mesh/Transform" + suffix] = polygonized(n); return 2ll * polygonized(n).Vertexes(); },
+      [&, suffix]()
+      {
+        const Frame frame = Frame::Translation(Vector(1.0, 0.0, 0.0)) * Frame::Rotation(Vector::Z, 0.5);
+        Mesh& mesh = copies["Mesh/Transform" + suffix];
+        mesh.Transform(frame);
+        mesh.Transform(frame.Inverse());
+      });
+
+    benchmark.Add("Mesh/Instanced" + suffix,
+      [&, n]() { return 64ll * polygonized(n).Vertexes(); },
+      [&, n]()
+      {
+        std::vector<Frame> frames;
+        for (int i = 0; i < 64; i++)
+        {
+          frames.push_back(Frame::Translation(Vector(3.0 * (i % 8), 3.0 * (i / 8), 0.0)) * Frame::Rotation(Vector::Z, 0.1 * i));
+        }
+        Mesh mesh = polygonized(n).Instanced(frames);
+        volatile int x = mesh.Vertexes(); (void)x;
+      });
+
+    benchmark.Add("Box/Vertices" + suffix,
+      [&, n]() { return (long long)polygonized(n).Vertexes(); },
+      [&, n]() { volatile double x = polygonized(n).GetBox()[1][0]; (void)x; });
+
+    // One ray against the boxes of all the triangles, one at a time and eight at a time
+    benchmark.Add("Box/Intersect" + suffix,
+      [&, n]() { return 16ll * triangleboxes(n).size(); },
+      [&, n]()
+      {
+        const std::vector<Box>& b = triangleboxes(n);
+        int hits = 0;
+        for (int r = 0; r < 16; r++)
+        {
+          const Vector d = Normalized(Vector(1.0, 0.1 * r, 0.3));
+          const Vector o = -3.0 * d;
+          const Vector inv = d.Inverse();
+          for (int i = 0; i < int(b.size()); i++)
+          {
+            double t0 = 0.0, t1 = Math::Infinity;
+            if (b[i].Intersect(o, inv, t0, t1))
+              hits++;
+          }
+        }
+        volatile int x = hits; (void)x;
+      });
+
+    benchmark.Add("Box/Intersect/Block" + suffix,
+      [&, n]()
+      {
+        const std::vector<Box>& b = triangleboxes(n);
+        const int count = int(b.size());
+        blocks[n].resize((count + BoxBlock::Width - 1) / BoxBlock::Width);
+        for (int i = 0; i < int(blocks[n].size()); i++)
+        {
+          blocks[n][i].Gather(b, i * BoxBlock::Width, std::min(BoxBlock::Width, count - i * BoxBlock::Width));
+        }
+        return 16ll * count;
+      },
+      [&, n]()
+      {
+        const std::vector<BoxBlock>& b = blocks[n];
+        alignas(64) double t[BoxBlock::Width];
+        int hits = 0;
+        for (int r = 0; r < 16; r++)
+        {
+          const Vector d = Normalized(Vector(1.0, 0.1 * r, 0.3));
+          const Vector o = -3.0 * d;
+          const Vector inv = d.Inverse();
+          for (int i = 0; i < int(b.size()); i++)
+          {
+            for (int mask = b[i].Intersect(o, inv, 0.0, Math::Infinity, t); mask != 0; mask &= mask - 1)
+              hits++;
+          }
+        }
+        volatile int x = hits; (void)x;
+      });
+
+    // Brute force ray casting, a small fixed set of rays against every triangle
+    benchmark.Add("Triangle/Intersect" + suffix,
+      [&, n]() { return 64ll * polygonized(n).Triangles(); },
+      [&, n]()
+      {
+        const Mesh& mesh = polygonized(n);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        int hits = 0;
+        for (int r = 0; r < 64; r++)
+        {
+          Vector d = Normalized(Vector(uniform(rng), uniform(rng), uniform(rng)));
+          Ray ray(-3.0 * d, d);
+          for (int i = 0; i < mesh.Triangles(); i++)
+          {
+            double t, u, v;
+            if (mesh.GetTriangle(i).Intersect(ray, t, u, v))
+              hits++;
+          }
+        }
+        volatile int x = hits; (void)x;
+      });
+
+    benchmark.Add("MeshBVH/Build" + suffix,
+      [&, n]() { return (long long)polygonized(n).Triangles(); },
+      [&, n]() { MeshBVH bvh(polygonized(n)); volatile int x = bvh.Nodes(); (void)x; });
+
+    // Refit of the hierarchy after the vertices moved, the work is the number of triangles
+    benchmark.Add("MeshBVH/Refit" + suffix,
+      [&, n]()
+      {
+        hierarchies[n] = MeshBVH(polygonized(n));
+        return (long long)(polygonized(n).Triangles());
+      },
+      [&, n]() { volatile int x = hierarchies[n].Refit(polygonized(n)); (void)x; });
+
+    // Closest and any hit queries of rays through the sphere, the work is the number of rays
+    auto rays = [](const MeshBVH& bvh)
+    {
+      std::mt19937 rng(7);
+      std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+      int hits = 0;
+      for (int r = 0; r < 4096; r++)
+      {
+        Vector d = Normalized(Vector(uniform(rng), uniform(rng), uniform(rng)));
+        Ray ray(-3.0 * d + 0.5 * Vector(uniform(rng), uniform(rng), uniform(rng)), d);
+        double t, u, v;
+        int i;
+        if (bvh.Intersect(ray, t, u, v, i))
+          hits++;
+        if (bvh.Occluded(ray))
+          hits++;
+      }
+      volatile int x = hits; (void)x;
+    };
+    benchmark.Add("MeshBVH/Intersect" + suffix,
+      [&, n]()
+      {
+        hierarchies[n] = MeshBVH(polygonized(n));
+        return 2ll * 4096;
+      },
+      [&, n]() { rays(hierarchies[n]); });
+
+    benchmark.Add("MeshBVH/Intersect/Watertight" + suffix,
+      [&, n]()
+      {
+        hierarchies[n] = MeshBVH(polygonized(n));
+        hierarchies[n].SetWatertight(true);
+        return 2ll * 4096;
+      },
+      [&, n]() { rays(hierarchies[n]); });
+
+    // Camera rays of a 512x512 image in tiles of 8x8 pixels, traced one at a time and as a stream of packets
+    auto camera = [&]()
+    {
+      if (cameras.empty())
+      {
+        const Camera view(Vector(-3.0, -2.0, 1.5), Vector::Null, Vector::Z);
+        for (int y = 0; y < 512; y += 8)
+          for (int x = 0; x < 512; x += 8)
+            for (int j = y; j < y + 8; j++)
+              for (int i = x; i < x + 8; i++)
+                cameras.push_back(view.PixelToRay(i, j, 512, 512));
+      }
+      return (long long)(cameras.size());
+    };
+    benchmark.Add("MeshBVH/Intersect/Camera" + suffix,
+      [&, n]()
+      {
+        hierarchies[n] = MeshBVH(polygonized(n));
+        return camera();
+      },
+      [&, n]()
+      {
+        const MeshBVH& bvh = hierarchies[n];
+        int hits = 0;
+        for (int r = 0; r < int(cameras.size()); r++)
+        {
+          double t, u, v;
+          int i;
+          if (bvh.Intersect(cameras[r], t, u, v, i))
+            hits++;
+        }
+        volatile int x = hits; (void)x;
+      });
+
+    benchmark.Add("MeshBVH/Intersect/Stream" + suffix,
+      [&, n]()
+      {
+        hierarchies[n] = MeshBVH(polygonized(n));
+        return camera();
+      },
+      [&, n]()
+      {
+        std::vector<MeshBVHHit> hits;
+        hierarchies[n].Intersect(cameras, hits);
+        volatile int x = hits[hits.size() / 2].index; (void)x;
+      });
+
+    // Signed distance of points in a thin shell around the sphere, the work is the number of points
+    benchmark.Add("MeshDistance/Signed" + suffix,
+      [&, n]()
+      {
+        distances[n] = MeshDistance(polygonized(n));
+        if (shell.empty())
+        {
+          std::mt19937 rng(11);
+          std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+          for (int i = 0; i < 65536; i++)
+          {
+            const Vector d = Normalized(Vector(uniform(rng), uniform(rng), uniform(rng)));
+            shell.push_back((1.0 + 0.05 * uniform(rng)) * d);
+          }
+        }
+        return (long long)(shell.size());
+      },
+      [&, n]()
+      {
+        std::vector<double> d;
+        distances[n].Signed(shell, d);
+        volatile double x = d[d.size() / 2]; (void)x;
+      });
+
+    // Signed distance grid of the sphere at the resolution of the polygonization, the work is the number of samples
+    // The setup checks that the grid agrees with the field of the sphere inside and outside
+    benchmark.Add("DistanceGrid/Build" + suffix,
+      [&, n]()
+      {
+        const DistanceGrid grid(polygonized(n), Box(1.2), n);
+        for (const Vector& p : { Vector::Null, Vector(0.5, 0.0, 0.0), Vector(1.1, 0.0, 0.0) })
+        {
+          if (fabs(grid.Value(p) - sphere.Value(p)) > 3.0 * grid.Spacing())
+          {
+            std::fprintf(stderr, "DistanceGrid/Build%s: %g instead of %g\n", suffix.c_str(), grid.Value(p), sphere.Value(p));
+            return -1ll;
+          }
+        }
+        return (long long)(n) * n * n;
+      },
+      [&, n]() { DistanceGrid grid(polygonized(n), Box(1.2), n); volatile double x = grid.Value(Vector::Null); (void)x; });
+
+    // Ambient occlusion with 16 rays per vertex, the work is the number of rays
+    benchmark.Add("MeshColor/AmbientOcclusion" + suffix,
+      [&, n]() { return 16ll * polygonized(n).Vertexes(); },
+      [&, n]() { MeshColor mesh(polygonized(n)); mesh.AmbientOcclusion(16); });
+
+    // Image of 512x512 pixels of the mesh, the work is the number of pixels
+    benchmark.Add("Renderer/Render" + suffix,
+      [&, n]()
+      {
+        renderers[n] = Renderer();
+        renderers[n].AddMesh(polygonized(n));
+        return 512ll * 512;
+      },
+      [&, n]()
+      {
+        std::vector<Color> image;
+        renderers[n].Render(Camera(Vector(-3.0, -2.0, 1.5), Vector::Null, Vector::Z), 512, 512, image);
+        volatile double x = image[image.size() / 2][0]; (void)x;
+      });
+  }
+
+  benchmark.Run(threads, filter);
+
+  // Generated .obj files, removed once the cases have run
+  for (const std::string& file : scratchfiles)
+  {
+    std::remove(file.c_str());
+  }
+
+  if (!output.empty())
+  {
+    benchmark.SaveJson(output);
+  }
+  if (!baseline.empty() && benchmark.Compare(Benchmark::LoadJson(baseline), tolerance) != 0)
+  {
+    return 2;
+  }
+  return benchmark.Failures() == 0 ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include "mathematics.h"
+#include "ray.h"
 
 class Box
 {
@@ -42,9 +43,16 @@ public:
   bool Inside(const Box&) const;
   bool Inside(const Vector&) const;
 
+  // Intersection
+  bool Intersect(const Ray&, double&, double&) const;
+  bool Intersect(const Vector&, const Vector&, double&, double&) const;
+
   double Volume() const;
   double Area() const;
 
+  // Distance
+  double R(const Vector&) const;
+
   // Compute sub-box
   Box Sub(int) const;
 
@@ -135,6 +143,21 @@ inline double Box::Area() const
   return 2.0 * (side[0] * side[1] + side[0] * side[2] + side[1] * side[2]);
 }
 
+/*!
+\brief Compute the squared distance between a point and the box, which is null inside the box.
+\param p Point.
+*/
+inline double Box::R(const Vector& p) const
+{
+  double r = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    const double s = p[i] < a[i] ? p[i] - a[i] : (p[i] > b[i] ? p[i] - b[i] : 0.0);
+    r += s * s;
+  }
+  return r;
+}
+
 /*!
 \brief Check if an argument box is inside the box.
 \param box The box.
@@ -170,3 +193,116 @@ inline int operator!=(const Box& a, const Box& b)
 {
   return !(a == b);
 }
+
+/*!
+\brief Clip an interval along a ray against the box.
+
+The direction of the ray is given by its inverse, computed once per ray with Vector::Inverse(),
+and the near and far planes of every slab are selected from the sign of the inverse. Null
+coordinates of the direction yield infinite inverses, and the undefined distances to the
+planes that contain the origin are ignored, so that rays parallel to a face and lying on its
+plane are considered inside the slab.
+\param o Origin of the ray.
+\param inv Inverse of the direction of the ray.
+\param tmin, tmax Interval along the ray, clipped to the box.
+\return True if the clipped interval is not empty.
+*/
+inline bool Box::Intersect(const Vector& o, const Vector& inv, double& tmin, double& tmax) const
+{
+  for (int k = 0; k < 3; k++)
+  {
+    const bool s = inv[k] < 0.0;
+    const double tn = ((s ? b[k] : a[k]) - o[k]) * inv[k];
+    const double tf = ((s ? a[k] : b[k]) - o[k]) * inv[k];
+    tmin = tn > tmin ? tn : tmin;
+    tmax = tf < tmax ? tf : tmax;
+  }
+  return tmin <= tmax;
+}
+
+// Block of boxes
+class BoxBlock
+{
+protected:
+  alignas(64) double c[2][3][8]; //!< Coordinates, indexed by box vertex, axis and lane.
+  int n = 0;                     //!< Number of boxes.
+public:
+  //! Empty.
+  BoxBlock() {}
+
+  //! Empty.
+  ~BoxBlock() {}
+
+  void Gather(const std::vector<Box>&, int, int);
+  void Set(int, const Box&);
+
+  int Size() const;
+  const double* Coordinates(int, int) const;
+  Box GetBox(int) const;
+
+  // Intersection
+  int Intersect(const Vector&, const Vector&, double, double, double*) const;
+public:
+  static const int Width = 8; //!< Number of lanes.
+};
+
+/*!
+\brief Gather a range of boxes, the lanes past the end of the range repeat the last box.
+\param boxes Array of boxes.
+\param first First box.
+\param count Number of boxes, between 1 and BoxBlock::Width.
+*/
+inline void BoxBlock::Gather(const std::vector<Box>& boxes, int first, int count)
+{
+  n = count;
+  for (int l = 0; l < Width; l++)
+  {
+    const Box& box = boxes[first + (l < count ? l : count - 1)];
+    for (int k = 0; k < 3; k++)
+    {
+      c[0][k][l] = box[0][k];
+      c[1][k][l] = box[1][k];
+    }
+  }
+}
+
+/*!
+\brief Set the box of a lane, the number of boxes is extended to the lane if need be.
+\param l Lane.
+\param box The box.
+*/
+inline void BoxBlock::Set(int l, const Box& box)
+{
+  for (int k = 0; k < 3; k++)
+  {
+    c[0][k][l] = box[0][k];
+    c[1][k][l] = box[1][k];
+  }
+  n = l < n ? n : l + 1;
+}
+
+//! Get the number of boxes.
+inline int BoxBlock::Size() const
+{
+  return n;
+}
+
+/*!
+\brief Get the coordinates along one axis of one vertex of all the boxes.
+\param k The box vertex: 0 for the lower vertex, 1 for the upper vertex.
+\param axis Axis.
+\return Array of BoxBlock::Width coordinates, aligned on 64 bytes.
+*/
+inline const double* BoxBlock::Coordinates(int k, int axis) const
+{
+  return c[k][axis];
+}
+
+/*!
+\brief Get a box.
+\param l Lane.
+*/
+inline Box BoxBlock::GetBox(int l) const
+{
+  return Box(Vector(c[0][0][l], c[0][1][l], c[0][2][l]), Vector(c[1][0][l], c[1][1][l], c[1][2][l]));
+}
@@ -0,0 +1,73 @@
+// Signed distance field sampled on a grid
+
+#pragma once
+
+#include "implicits.h"
+
+class DistanceGrid : public AnalyticScalarField
+{
+protected:
+  Box box;                    //!< Box of the grid, the samples start at its lower vertex.
+  int nx = 0, ny = 0, nz = 0; //!< Number of samples along the axes.
+  double h = 0.0;             //!< Spacing of the samples.
+  std::vector<float> field;   //!< Signed distances at the samples, with x varying fastest.
+public:
+  explicit DistanceGrid(const Mesh&, const Box&, int);
+
+  //! Empty.
+  ~DistanceGrid() {}
+
+  double Value(const Vector&) const override;
+  Vector Gradient(const Vector&) const override;
+
+  int Index(int, int, int) const;
+  Vector Vertex(int, int, int) const;
+  double Sample(int, int, int) const;
+  Box GetBox() const;
+  double Spacing() const;
+protected:
+  Vector Cell(const Vector&, int&, int&, int&, double&, double&, double&) const;
+  void Sweep(const std::vector<char>&);
+public:
+  static const int Band = 2;  //!< Width of the narrow band of exact distances, in samples.
+  static const int Brick = 8; //!< Size of the bricks of samples that may intersect the narrow band.
+};
+
+/*!
+\brief Get the index of a sample.
+\param i, j, k Integer coordinates.
+*/
+inline int DistanceGrid::Index(int i, int j, int k) const
+{
+  return i + nx * (j + ny * k);
+}
+
+/*!
+\brief Get the position of a sample.
+\param i, j, k Integer coordinates.
+*/
+inline Vector DistanceGrid::Vertex(int i, int j, int k) const
+{
+  return box[0] + h * Vector(i, j, k);
+}
+
+/*!
+\brief Get the signed distance at a sample.
+\param i, j, k Integer coordinates.
+*/
+inline double DistanceGrid::Sample(int i, int j, int k) const
+{
+  return field[Index(i, j, k)];
+}
+
+//! Get the box of the grid.
+inline Box DistanceGrid::GetBox() const
+{
+  return box;
+}
+
+//! Get the spacing of the samples.
+inline double DistanceGrid::Spacing() const
+{
+  return h;
+}
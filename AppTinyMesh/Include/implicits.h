@@ -20,9 +20,15 @@ public:
   // Dichotomy
   Vector Dichotomy(Vector, Vector, double, double, double, const double& = 1.0e-4) const;
 
+  // Sphere tracing
+  virtual double Lipschitz() const;
+  bool Intersect(const Ray&, double&, double, double = 1.0, const double& = 1.0e-4) const;
+  int Intersect(const std::vector<Ray>&, std::vector<double>&, double, double = 1.0, const double& = 1.0e-4) const;
+
   virtual void Polygonize(int, Mesh&, const Box&, const double& = 1e-4) const;
 protected:
   static const double Epsilon; //!< Epsilon value for partial derivatives
+  static const int Steps = 1024; //!< Maximum number of steps of sphere tracing.
 protected:
   static int TriangleTable[256][16]; //!< Two dimensionnal array storing the straddling edges for every marching cubes configuration.
   static int edgeTable[256];    //!< Array storing straddling edges for every marching cubes configuration.
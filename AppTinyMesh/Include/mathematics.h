@@ -1,6 +1,7 @@
 #pragma once
 
 #include <math.h>
+#include <limits>
 #include <ostream>
 
 class Math
@@ -16,6 +17,8 @@ public:
 
   static constexpr double DegreeToRadian(double);
   static constexpr double RadianToDegree(double);
+public:
+  static constexpr double Infinity = std::numeric_limits<double>::infinity(); //!< Infinity.
 };
 
 /*!
@@ -454,3 +457,143 @@ inline Vector Vector::Bilinear(const Vector& a00, const Vector& a10, const Vecto
 {
   return (1 - u) * (1 - v) * a00 + (1 - u) * (v)*a01 + (u) * (1 - v) * a10 + (u) * (v)*a11;
 }
+
+// Affine transformation
+class Frame
+{
+protected:
+  double r[3][4]; //!< Rows of the matrix, the last column is the translation.
+public:
+  explicit Frame();
+  explicit Frame(const Vector&);
+  explicit Frame(const Vector&, const Vector&, const Vector&, const Vector& = Vector::Null);
+
+  //! Empty.
+  ~Frame() {}
+
+  double operator()(int, int) const;
+  double& operator()(int, int);
+
+  Vector Column(int) const;
+  Vector Translation() const;
+
+  // Transformations
+  Vector Transform(const Vector&) const;
+  Vector TransformVector(const Vector&) const;
+  Vector TransformNormal(const Vector&) const;
+
+  double Determinant() const;
+  Frame Inverse() const;
+  Frame NormalFrame() const;
+
+  friend Frame operator*(const Frame&, const Frame&);
+
+  static Frame Translation(const Vector&);
+  static Frame Rotation(const Vector&, double);
+  static Frame Scaling(const Vector&);
+
+  friend std::ostream& operator<<(std::ostream&, const Frame&);
+public:
+  static const Frame Id; //!< Identity.
+};
+
+//! Create the identity.
+inline Frame::Frame() :Frame(Vector(0.0))
+{
+}
+
+/*!
+\brief Create a translation.
+\param t Translation.
+*/
+inline Frame::Frame(const Vector& t) :Frame(Vector(1.0, 0.0, 0.0), Vector(0.0, 1.0, 0.0), Vector(0.0, 0.0, 1.0), t)
+{
+}
+
+/*!
+\brief Create a frame from the images of the axes and a translation.
+\param x, y, z Columns of the linear part.
+\param t Translation.
+*/
+inline Frame::Frame(const Vector& x, const Vector& y, const Vector& z, const Vector& t)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    r[i][0] = x[i];
+    r[i][1] = y[i];
+    r[i][2] = z[i];
+    r[i][3] = t[i];
+  }
+}
+
+/*!
+\brief Get a coefficient of the matrix.
+\param i, j Row and column, the column 3 is the translation.
+*/
+inline double Frame::operator()(int i, int j) const
+{
+  return r[i][j];
+}
+
+/*!
+\brief Get a coefficient of the matrix.
+\param i, j Row and column, the column 3 is the translation.
+*/
+inline double& Frame::operator()(int i, int j)
+{
+  return r[i][j];
+}
+
+/*!
+\brief Get a column of the matrix.
+\param j Column, the column 3 is the translation.
+*/
+inline Vector Frame::Column(int j) const
+{
+  return Vector(r[0][j], r[1][j], r[2][j]);
+}
+
+//! Get the translation.
+inline Vector Frame::Translation() const
+{
+  return Column(3);
+}
+
+/*!
+\brief Transform a point.
+\param p Point.
+*/
+inline Vector Frame::Transform(const Vector& p) const
+{
+  return Vector(r[0][0] * p[0] + r[0][1] * p[1] + r[0][2] * p[2] + r[0][3],
+    r[1][0] * p[0] + r[1][1] * p[1] + r[1][2] * p[2] + r[1][3],
+    r[2][0] * p[0] + r[2][1] * p[1] + r[2][2] * p[2] + r[2][3]);
+}
+
+/*!
+\brief Transform a vector, the translation is ignored.
+\param v Vector.
+*/
+inline Vector Frame::TransformVector(const Vector& v) const
+{
+  return Vector(r[0][0] * v[0] + r[0][1] * v[1] + r[0][2] * v[2],
+    r[1][0] * v[0] + r[1][1] * v[1] + r[1][2] * v[2],
+    r[2][0] * v[0] + r[2][1] * v[1] + r[2][2] * v[2]);
+}
+
+/*!
+\brief Transform a normal by the inverse transpose of the linear part.
+
+This is slow as the inverse is computed on every call, use NormalFrame() to transform many normals.
+\param n Normal.
+*/
+inline Vector Frame::TransformNormal(const Vector& n) const
+{
+  return Normalized(NormalFrame().TransformVector(n));
+}
+
+//! Compute the determinant of the linear part.
+inline double Frame::Determinant() const
+{
+  return r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1]) - r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0]) + r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+}
@@ -4,6 +4,8 @@
 #include "ray.h"
 #include "mathematics.h"
 
+#include <memory>
+
 // Triangle
 class Triangle
 {
@@ -25,6 +27,9 @@ public:
   // Intersection
   bool Intersect(const Ray&, double&, double&, double&) const;
 
+  // Distance
+  Vector Closest(const Vector&, double&, double&) const;
+
   void Translate(const Vector&);
 
   // Geometry
@@ -78,7 +83,227 @@ inline Triangle::Triangle(const Vector& a, const Vector& b, const Vector& c)
 }
 
 
+// Block of triangles in structure of arrays layout
+class TriangleBlock
+{
+protected:
+  alignas(64) double c[3][3][8]; //!< Coordinates, indexed by triangle vertex, axis and lane.
+  int index[8];                  //!< Triangle indexes.
+  int n = 0;                     //!< Number of triangles.
+public:
+  //! Empty.
+  TriangleBlock() {}
+
+  //! Empty.
+  ~TriangleBlock() {}
+
+  void Gather(const std::vector<Vector>&, const std::vector<int>&, int, int);
+
+  int Size() const;
+  int Index(int) const;
+  const double* Coordinates(int, int) const;
+  Vector Vertex(int, int) const;
+  Triangle GetTriangle(int) const;
+public:
+  static const int Width = 8; //!< Number of lanes.
+};
+
+/*!
+\brief Gather a range of triangles, the lanes past the end of the range repeat the last triangle.
+\param vertices Array of vertices.
+\param varray Vertex indexes.
+\param first First triangle.
+\param count Number of triangles, between 1 and TriangleBlock::Width.
+*/
+inline void TriangleBlock::Gather(const std::vector<Vector>& vertices, const std::vector<int>& varray, int first, int count)
+{
+  n = count;
+  for (int l = 0; l < Width; l++)
+  {
+    const int t = first + (l < count ? l : count - 1);
+    index[l] = t;
+    for (int k = 0; k < 3; k++)
+    {
+      const Vector& p = vertices[varray[3 * t + k]];
+      c[k][0][l] = p[0];
+      c[k][1][l] = p[1];
+      c[k][2][l] = p[2];
+    }
+  }
+}
+
+//! Get the number of triangles.
+inline int TriangleBlock::Size() const
+{
+  return n;
+}
+
+/*!
+\brief Get the index of the triangle of a lane in the mesh.
+\param l Lane.
+*/
+inline int TriangleBlock::Index(int l) const
+{
+  return index[l];
+}
+
+/*!
+\brief Get the coordinates along one axis of one vertex of all the triangles.
+\param k The triangle vertex: 0, 1, or 2.
+\param axis Axis.
+\return Array of TriangleBlock::Width coordinates, aligned on 64 bytes.
+*/
+inline const double* TriangleBlock::Coordinates(int k, int axis) const
+{
+  return c[k][axis];
+}
+
+/*!
+\brief Get a vertex of a triangle.
+\param l Lane.
+\param k The triangle vertex: 0, 1, or 2.
+*/
+inline Vector TriangleBlock::Vertex(int l, int k) const
+{
+  return Vector(c[k][0][l], c[k][1][l], c[k][2][l]);
+}
+
+/*!
+\brief Get a triangle.
+\param l Lane.
+*/
+inline Triangle TriangleBlock::GetTriangle(int l) const
+{
+  return Triangle(Vertex(l, 0), Vertex(l, 1), Vertex(l, 2));
+}
+
+
+// Block of triangles in single precision and structure of arrays layout, for ray intersections
+class TriangleBlockF
+{
+protected:
+  alignas(32) float c[3][3][8]; //!< Coordinates, indexed by triangle vertex, axis and lane.
+  int index[8];                 //!< Triangle indexes.
+  int n = 0;                    //!< Number of triangles.
+public:
+  //! Empty.
+  TriangleBlockF() {}
+
+  //! Empty.
+  ~TriangleBlockF() {}
+
+  void Gather(const std::vector<Vector>&, const std::vector<int>&, int, int);
+  void Gather(const Vector*, int, int);
+
+  int Size() const;
+  int Index(int) const;
+  const float* Coordinates(int, int) const;
+  Vector Vertex(int, int) const;
+  Triangle GetTriangle(int) const;
+
+  // Intersection
+  int Intersect(const RayF&, float, float&, float&, float&, bool = false) const;
+protected:
+  static bool Watertight(const float*, const float*, const float*, float, float&, float&, float&);
+public:
+  static const int Width = 8; //!< Number of lanes.
+};
+
+/*!
+\brief Gather a range of triangles, the lanes past the end of the range repeat the last triangle.
+\param vertices Array of vertices.
+\param varray Vertex indexes.
+\param first First triangle.
+\param count Number of triangles, between 1 and TriangleBlockF::Width.
+*/
+inline void TriangleBlockF::Gather(const std::vector<Vector>& vertices, const std::vector<int>& varray, int first, int count)
+{
+  n = count;
+  for (int l = 0; l < Width; l++)
+  {
+    const int t = first + (l < count ? l : count - 1);
+    index[l] = t;
+    for (int k = 0; k < 3; k++)
+    {
+      const Vector& p = vertices[varray[3 * t + k]];
+      c[k][0][l] = float(p[0]);
+      c[k][1][l] = float(p[1]);
+      c[k][2][l] = float(p[2]);
+    }
+  }
+}
+
+/*!
+\brief Gather a range of triangles stored as three consecutive vertices, the lanes past the end of the range repeat the last triangle.
+\param vertices Array of vertices, three per triangle.
+\param first First triangle.
+\param count Number of triangles, between 1 and TriangleBlockF::Width.
+*/
+inline void TriangleBlockF::Gather(const Vector* vertices, int first, int count)
+{
+  n = count;
+  for (int l = 0; l < Width; l++)
+  {
+    const int t = first + (l < count ? l : count - 1);
+    index[l] = t;
+    for (int k = 0; k < 3; k++)
+    {
+      const Vector& p = vertices[3 * t + k];
+      c[k][0][l] = float(p[0]);
+      c[k][1][l] = float(p[1]);
+      c[k][2][l] = float(p[2]);
+    }
+  }
+}
+
+//! Get the number of triangles.
+inline int TriangleBlockF::Size() const
+{
+  return n;
+}
+
+/*!
+\brief Get the index of the triangle of a lane.
+\param l Lane.
+*/
+inline int TriangleBlockF::Index(int l) const
+{
+  return index[l];
+}
+
+/*!
+\brief Get the coordinates along one axis of one vertex of all the triangles.
+\param k The triangle vertex: 0, 1, or 2.
+\param axis Axis.
+\return Array of TriangleBlockF::Width coordinates, aligned on 32 bytes.
+*/
+inline const float* TriangleBlockF::Coordinates(int k, int axis) const
+{
+  return c[k][axis];
+}
+
+/*!
+\brief Get a vertex of a triangle.
+\param l Lane.
+\param k The triangle vertex: 0, 1, or 2.
+*/
+inline Vector TriangleBlockF::Vertex(int l, int k) const
+{
+  return Vector(c[k][0][l], c[k][1][l], c[k][2][l]);
+}
+
+/*!
+\brief Get a triangle.
+\param l Lane.
+*/
+inline Triangle TriangleBlockF::GetTriangle(int l) const
+{
+  return Triangle(Vertex(l, 0), Vertex(l, 1), Vertex(l, 2));
+}
+
+
 class QString;
+class MeshTopology;
 
 class Mesh
 {
@@ -87,11 +312,20 @@ protected:
   std::vector<Vector> normals;  //!< Normals.
   std::vector<int> varray;     //!< Vertex indexes.
   std::vector<int> narray;     //!< Normal indexes.
+
+  mutable std::shared_ptr<const MeshTopology> topology; //!< Cached topology, built on demand.
 public:
   explicit Mesh();
   explicit Mesh(const std::vector<Vector>&, const std::vector<int>&);
   explicit Mesh(const std::vector<Vector>&, const std::vector<Vector>&, const std::vector<int>&, const std::vector<int>&);
-  ~Mesh();
+  explicit Mesh(std::vector<Vector>&&, std::vector<int>&&);
+  explicit Mesh(std::vector<Vector>&&, std::vector<Vector>&&, std::vector<int>&&, std::vector<int>&&);
+  Mesh(const Mesh&) = default;
+  Mesh(Mesh&&) = default;
+  virtual ~Mesh();
+
+  Mesh& operator=(const Mesh&) = default;
+  Mesh& operator=(Mesh&&) = default;
 
   void Reserve(int, int, int, int);
 
@@ -104,8 +338,10 @@ public:
   int Triangles() const;
   int Vertexes() const;
 
-  std::vector<int> VertexIndexes() const;
-  std::vector<int> NormalIndexes() const;
+  const std::vector<Vector>& Vertices() const;
+  const std::vector<Vector>& Normals() const;
+  const std::vector<int>& VertexIndexes() const;
+  const std::vector<int>& NormalIndexes() const;
 
   int VertexIndex(int, int) const;
   int NormalIndex(int, int) const;
@@ -114,26 +350,73 @@ public:
 
   Box GetBox() const;
 
+  // Bulk traversal
+  template<typename F>
+  void ForEachTriangle(F, bool = false) const;
+  template<typename F>
+  void ForEachTriangleBlock(F, bool = false) const;
+
   void Scale(double);
+  void Transform(const Frame&);
+  Mesh Instanced(const std::vector<Frame>&) const;
 
   void SmoothNormals();
 
+  // Smoothing
+  void Smooth(int, double = 0.5, double = 0.0, bool = false, double = -1.0, bool = true);
+  void Laplacian(int, double = 0.5, bool = false);
+  void Taubin(int, double = 0.5, double = -0.53, bool = false);
+
+  // Processing
+  void Weld(double);
+  void Decimate(int, double = -1.0, bool = false);
+  void OptimizeCache(int = 16, bool = false);
+  double CacheMissRatio(int = 16) const;
+  void SpatialSort(bool = false);
+  void Subdivide(int = 1);
+
+  // Adjacency
+  void VertexTriangles(std::vector<int>&, std::vector<int>&) const;
+  const MeshTopology& Topology() const;
+  void OneRing(int, std::vector<int>&) const;
+
   // Constructors from core classes
   explicit Mesh(const Box&);
 
   void Load(const QString&);
   void SaveObj(const QString&, const QString&) const;
 protected:
+  void Modified();
+  virtual void Remap(const std::vector<int>&, const std::vector<int>&, const std::vector<int>&);
+  virtual int VertexAttributes(std::vector<double>&) const;
+  virtual void SetVertexAttributes(const std::vector<double>&, int);
+
   void AddTriangle(int, int, int, int);
   void AddSmoothTriangle(int, int, int, int, int, int);
   void AddSmoothQuadrangle(int, int, int, int, int, int, int, int);
   void AddQuadrangle(int, int, int, int);
 };
 
+/*!
+\brief Return the array of vertices.
+*/
+inline const std::vector<Vector>& Mesh::Vertices() const
+{
+  return vertices;
+}
+
+/*!
+\brief Return the array of normals.
+*/
+inline const std::vector<Vector>& Mesh::Normals() const
+{
+  return normals;
+}
+
 /*!
 \brief Return the set of vertex indexes.
 */
-inline std::vector<int> Mesh::VertexIndexes() const
+inline const std::vector<int>& Mesh::VertexIndexes() const
 {
   return varray;
 }
@@ -141,7 +424,7 @@ inline std::vector<int> Mesh::VertexIndexes() const
 /*!
 \brief Return the set of normal indexes.
 */
-inline std::vector<int> Mesh::NormalIndexes() const
+inline const std::vector<int>& Mesh::NormalIndexes() const
 {
   return narray;
 }
@@ -235,3 +518,78 @@ inline Vector Mesh::operator[](int i) const
   return vertices[i];
 }
 
+/*!
+\brief Smooth the mesh with the Laplacian operator, boundary vertices are locked.
+
+This shrinks the mesh, see Taubin() for a smoothing that preserves the volume.
+\param iterations Number of iterations.
+\param lambda Scale factor, in [0,1].
+\param cotangent Use cotangent weights instead of uniform weights.
+\sa Smooth()
+*/
+inline void Mesh::Laplacian(int iterations, double lambda, bool cotangent)
+{
+  Smooth(iterations, lambda, 0.0, cotangent);
+}
+
+/*!
+\brief Smooth the mesh with the Taubin &lambda;|&mu; filter [Taubin 1995], boundary vertices are locked.
+
+Every iteration is a shrinking Laplacian step followed by an inflating one, with -&mu; slightly larger than &lambda;.
+\param iterations Number of iterations.
+\param lambda, mu Scale factors.
+\param cotangent Use cotangent weights instead of uniform weights.
+\sa Smooth()
+*/
+inline void Mesh::Taubin(int iterations, double lambda, double mu, bool cotangent)
+{
+  Smooth(iterations, lambda, mu, cotangent);
+}
+
+/*!
+\brief Visit all the triangles without copies nor bounds checks.
+
+The function is called with the index of the triangle and references to its three vertices:
+\code
+double area = 0.0;
+mesh.ForEachTriangle([&](int i, const Vector& a, const Vector& b, const Vector& c) { area += 0.5 * Norm((b - a) / (c - a)); });
+\endcode
+\param f Function.
+\param parallel Call the function from several threads, for disjoint triangles.
+*/
+template<typename F>
+inline void Mesh::ForEachTriangle(F f, bool parallel) const
+{
+  const int nt = Triangles();
+  const Vector* v = vertices.data();
+  const int* index = varray.data();
+
+#pragma omp parallel for schedule(static) if(parallel)
+  for (int i = 0; i < nt; i++)
+  {
+    f(i, v[index[3 * i]], v[index[3 * i + 1]], v[index[3 * i + 2]]);
+  }
+}
+
+/*!
+\brief Visit all the triangles by blocks of TriangleBlock::Width triangles gathered in structure of arrays layout, for SIMD processing.
+
+The last block may be partial, see TriangleBlock::Gather().
+\param f Function, called with a const reference to the block.
+\param parallel Call the function from several threads, for disjoint blocks.
+*/
+template<typename F>
+inline void Mesh::ForEachTriangleBlock(F f, bool parallel) const
+{
+  const int nt = Triangles();
+  const int nb = (nt + TriangleBlock::Width - 1) / TriangleBlock::Width;
+
+#pragma omp parallel for schedule(static) if(parallel)
+  for (int b = 0; b < nb; b++)
+  {
+    const int first = b * TriangleBlock::Width;
+    TriangleBlock block;
+    block.Gather(vertices, varray, first, nt - first < TriangleBlock::Width ? nt - first : TriangleBlock::Width);
+    f(static_cast<const TriangleBlock&>(block));
+  }
+}
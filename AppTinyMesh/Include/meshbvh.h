@@ -0,0 +1,140 @@
+// Bounding volume hierarchy
+
+#pragma once
+
+#include "mesh.h"
+
+// Node of a flattened hierarchy, one cache line
+class alignas(64) MeshBVHNode
+{
+public:
+  Box box;     //!< Box.
+  int index;   //!< First triangle of a leaf, or second child of an internal node whose first child is the next node.
+  int count;   //!< Number of triangles of a leaf, zero for internal nodes.
+  int axis;    //!< Split axis of an internal node.
+  int block;   //!< Triangle block of a leaf.
+public:
+  bool IsLeaf() const;
+  Box GetBox() const;
+};
+
+//! Check if the node is a leaf.
+inline bool MeshBVHNode::IsLeaf() const
+{
+  return count != 0;
+}
+
+//! Get the box of the node.
+inline Box MeshBVHNode::GetBox() const
+{
+  return box;
+}
+
+// Closest intersection of a ray, returned by the queries of ray packets and streams
+class MeshBVHHit
+{
+public:
+  double t = Math::Infinity; //!< Intersection depth.
+  double u = 0.0, v = 0.0;   //!< Parametric coordinates of the intersection in the triangle.
+  int index = -1;            //!< Index of the intersected triangle in the mesh, -1 if none.
+public:
+  bool IsHit() const;
+};
+
+//! Check if the ray intersects a triangle.
+inline bool MeshBVHHit::IsHit() const
+{
+  return index != -1;
+}
+
+class MeshBVH
+{
+protected:
+  std::vector<MeshBVHNode> nodes;     //!< Nodes in depth first order, the root is the first node.
+  std::vector<int> index;             //!< Triangle indexes of the mesh, in leaf order.
+  std::vector<Vector> vertices;       //!< Vertices of the triangles in leaf order, three per triangle.
+  std::vector<TriangleBlockF> blocks; //!< Triangles of every leaf in single precision.
+  std::vector<double> costs;          //!< Relative cost of the subtrees when they were built, which detects their degradation after refitting.
+  int depth = 0;                      //!< Depth of the hierarchy.
+  bool watertight = false;            //!< Watertight intersections.
+public:
+  //! Empty.
+  MeshBVH() {}
+  explicit MeshBVH(const Mesh&);
+
+  //! Empty.
+  ~MeshBVH() {}
+
+  int Nodes() const;
+  int Triangles() const;
+  int Depth() const;
+  const MeshBVHNode& Node(int) const;
+  Box GetBox() const;
+  double Cost() const;
+  size_t Memory() const;
+
+  void SetWatertight(bool);
+
+  // Deformations
+  int Refit(const Mesh&, double = 0.0);
+
+  // Queries
+  bool Intersect(const Ray&, double&, double&, double&, int&, double = Math::Infinity) const;
+  bool Occluded(const Ray&, double = Math::Infinity) const;
+  double Closest(const Vector&, Vector&, double&, double&, int&, double = Math::Infinity) const;
+  int Intersect(const Ray*, int, MeshBVHHit*, double = Math::Infinity) const;
+  void Intersect(const std::vector<Ray>&, std::vector<MeshBVHHit>&, double = Math::Infinity) const;
+protected:
+  void Gather();
+  void Fit(std::vector<double>&);
+  void Rebuild(const std::vector<int>&, const std::vector<int>&);
+public:
+  static const int Bins = 16;                        //!< Number of bins per axis for evaluating the surface area heuristic.
+  static const int LeafSize = TriangleBlockF::Width; //!< Maximum number of triangles in a leaf, which are intersected as one block.
+  static const int MaxDepth = 64;                    //!< Depth beyond which nodes are split at the median.
+  static const int PacketSize = 64;                  //!< Maximum number of rays traversed together, such as a tile of 8&times;8 pixels.
+};
+
+//! Get the number of nodes.
+inline int MeshBVH::Nodes() const
+{
+  return int(nodes.size());
+}
+
+//! Get the number of triangles.
+inline int MeshBVH::Triangles() const
+{
+  return int(index.size());
+}
+
+//! Get the depth of the hierarchy, a single leaf has depth one.
+inline int MeshBVH::Depth() const
+{
+  return depth;
+}
+
+/*!
+\brief Get a node.
+\param i Index.
+*/
+inline const MeshBVHNode& MeshBVH::Node(int i) const
+{
+  return nodes[i];
+}
+
+//! Get the box of the hierarchy.
+inline Box MeshBVH::GetBox() const
+{
+  return nodes.empty() ? Box::Null : nodes[0].GetBox();
+}
+
+/*!
+\brief Set the intersection mode of the triangles.
+
+Watertight intersections never miss the edges and vertices shared by adjacent triangles, see TriangleBlockF::Intersect().
+\param w Watertight mode.
+*/
+inline void MeshBVH::SetWatertight(bool w)
+{
+  watertight = w;
+}
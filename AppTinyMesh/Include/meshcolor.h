@@ -14,11 +14,24 @@ public:
   explicit MeshColor();
   explicit MeshColor(const Mesh&);
   explicit MeshColor(const Mesh&, const std::vector<Color>&, const std::vector<int>&);
+  explicit MeshColor(Mesh&&);
+  explicit MeshColor(Mesh&&, std::vector<Color>&&, std::vector<int>&&);
+  MeshColor(const MeshColor&) = default;
+  MeshColor(MeshColor&&) = default;
   ~MeshColor();
 
+  MeshColor& operator=(const MeshColor&) = default;
+  MeshColor& operator=(MeshColor&&) = default;
+
   Color GetColor(int) const;
-  std::vector<Color> GetColors() const;
-  std::vector<int> ColorIndexes() const;
+  const std::vector<Color>& GetColors() const;
+  const std::vector<int>& ColorIndexes() const;
+
+  void AmbientOcclusion(int = 64, double = Math::Infinity, unsigned int = 0);
+protected:
+  void Remap(const std::vector<int>&, const std::vector<int>&, const std::vector<int>&) override;
+  int VertexAttributes(std::vector<double>&) const override;
+  void SetVertexAttributes(const std::vector<double>&, int) override;
 };
 
 /*!
@@ -34,7 +47,7 @@ inline Color MeshColor::GetColor(int i) const
 /*!
 \brief Get the array of colors.
 */
-inline std::vector<Color> MeshColor::GetColors() const
+inline const std::vector<Color>& MeshColor::GetColors() const
 {
   return colors;
 }
@@ -42,7 +55,7 @@ inline std::vector<Color> MeshColor::GetColors() const
 /*!
 \brief Return the set of color indices.
 */
-inline std::vector<int> MeshColor::ColorIndexes() const
+inline const std::vector<int>& MeshColor::ColorIndexes() const
 {
   return carray;
 }
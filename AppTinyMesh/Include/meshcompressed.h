@@ -0,0 +1,87 @@
+// Compressed mesh
+
+#pragma once
+
+#include "mesh.h"
+
+class MeshCompressed
+{
+protected:
+  Box box = Box::Null;                  //!< Box of the vertices, range of the quantized coordinates.
+  Vector step = Vector::Null;           //!< Quantization step along the axes.
+  std::vector<unsigned short> px;       //!< Quantized x coordinates.
+  std::vector<unsigned short> py;       //!< Quantized y coordinates.
+  std::vector<unsigned short> pz;       //!< Quantized z coordinates.
+  std::vector<short> ou;                //!< First octahedral coordinate of the normals.
+  std::vector<short> ov;                //!< Second octahedral coordinate of the normals.
+  std::vector<unsigned char> vstream;   //!< Encoded vertex indexes.
+  std::vector<unsigned char> nstream;   //!< Encoded normal indexes, empty if normals are indexed like the vertices or not indexed.
+  std::vector<unsigned int> voffset;    //!< Offsets of the blocks in the vertex index stream.
+  std::vector<unsigned int> noffset;    //!< Offsets of the blocks in the normal index stream.
+  int triangles = 0;                    //!< Number of triangles.
+  bool normalIndexes = false;           //!< Whether the mesh has normal indexes.
+public:
+  //! Empty.
+  MeshCompressed() {}
+  explicit MeshCompressed(const Mesh&);
+
+  //! Empty.
+  ~MeshCompressed() {}
+
+  int Vertexes() const;
+  int Triangles() const;
+  int Blocks() const;
+
+  Box GetBox() const;
+
+  // Random access
+  Vector Vertex(int) const;
+  Vector Normal(int) const;
+  int VertexIndex(int, int) const;
+  int NormalIndex(int, int) const;
+  Triangle GetTriangle(int) const;
+
+  // Bulk decoding
+  int DecodeBlock(int, int*, int*) const;
+  void DecodeVertices(int, int, Vector*) const;
+  void DecodeNormals(int, int, Vector*) const;
+
+  Mesh ToMesh() const;
+
+  size_t Memory() const;
+public:
+  static const int BlockSize = 64; //!< Number of triangles per block of indexes.
+};
+
+//! Get the number of vertices.
+inline int MeshCompressed::Vertexes() const
+{
+  return int(px.size());
+}
+
+//! Get the number of triangles.
+inline int MeshCompressed::Triangles() const
+{
+  return triangles;
+}
+
+//! Get the number of blocks of triangles.
+inline int MeshCompressed::Blocks() const
+{
+  return (triangles + BlockSize - 1) / BlockSize;
+}
+
+//! Get the box of the vertices, which defines the range of the quantized coordinates.
+inline Box MeshCompressed::GetBox() const
+{
+  return box;
+}
+
+/*!
+\brief Get a vertex.
+\param i Index.
+*/
+inline Vector MeshCompressed::Vertex(int i) const
+{
+  return box[0] + Vector(double(px[i]) * step[0], double(py[i]) * step[1], double(pz[i]) * step[2]);
+}
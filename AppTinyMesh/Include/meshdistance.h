@@ -0,0 +1,38 @@
+// Distance to a mesh
+
+#pragma once
+
+#include "meshbvh.h"
+
+class MeshDistance
+{
+protected:
+  MeshBVH bvh;                  //!< Hierarchy of the triangles.
+  std::vector<int> varray;      //!< Vertex indexes of the triangles.
+  std::vector<Vector> faces;    //!< Unit normals of the triangles.
+  std::vector<Vector> edges;    //!< Pseudo-normals of the edges, one per half-edge.
+  std::vector<Vector> vertices; //!< Angle weighted pseudo-normals of the vertices.
+public:
+  //! Empty.
+  MeshDistance() {}
+  explicit MeshDistance(const Mesh&);
+
+  //! Empty.
+  ~MeshDistance() {}
+
+  const MeshBVH& Hierarchy() const;
+
+  // Queries
+  double Distance(const Vector&, double = Math::Infinity) const;
+  double Signed(const Vector&, double = Math::Infinity) const;
+  void Distance(const std::vector<Vector>&, std::vector<double>&, double = Math::Infinity) const;
+  void Signed(const std::vector<Vector>&, std::vector<double>&, double = Math::Infinity) const;
+protected:
+  Vector PseudoNormal(int, double, double) const;
+};
+
+//! Get the hierarchy of the triangles.
+inline const MeshBVH& MeshDistance::Hierarchy() const
+{
+  return bvh;
+}
@@ -0,0 +1,243 @@
+// Single precision mesh
+
+#pragma once
+
+#include "meshcolor.h"
+
+// Single precision vector
+class VectorF
+{
+protected:
+  float c[3]; //!< Components.
+public:
+  //! Empty.
+  VectorF() {}
+  explicit VectorF(float, float, float);
+  explicit VectorF(const Vector&);
+
+  float operator[] (int) const;
+  float& operator[] (int);
+
+  Vector ToVector() const;
+};
+
+/*!
+\brief Create a vector with argument coordinates.
+\param a,b,c Coordinates.
+*/
+inline VectorF::VectorF(float a, float b, float c)
+{
+  VectorF::c[0] = a;
+  VectorF::c[1] = b;
+  VectorF::c[2] = c;
+}
+
+/*!
+\brief Create a vector rounded from a double precision vector.
+\param v Vector.
+*/
+inline VectorF::VectorF(const Vector& v)
+{
+  c[0] = float(v[0]);
+  c[1] = float(v[1]);
+  c[2] = float(v[2]);
+}
+
+/*!
+\brief Get the i-th coordinate.
+\param i Index.
+*/
+inline float VectorF::operator[] (int i) const
+{
+  return c[i];
+}
+
+/*!
+\brief Get the i-th coordinate.
+\param i Index.
+*/
+inline float& VectorF::operator[] (int i)
+{
+  return c[i];
+}
+
+//! Convert to a double precision vector.
+inline Vector VectorF::ToVector() const
+{
+  return Vector(c[0], c[1], c[2]);
+}
+
+// Single precision color
+class ColorF
+{
+protected:
+  float c[4]; //!< Components, including alpha.
+public:
+  //! Empty.
+  ColorF() {}
+  explicit ColorF(const Color&);
+
+  float operator[] (int) const;
+
+  Color ToColor() const;
+};
+
+/*!
+\brief Create a color rounded from a double precision color.
+\param color Color.
+*/
+inline ColorF::ColorF(const Color& color)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    c[i] = float(color[i]);
+  }
+}
+
+/*!
+\brief Get the i-th channel.
+\param i Index.
+*/
+inline float ColorF::operator[] (int i) const
+{
+  return c[i];
+}
+
+//! Convert to a double precision color.
+inline Color ColorF::ToColor() const
+{
+  return Color(c[0], c[1], c[2], c[3]);
+}
+
+class MeshF
+{
+protected:
+  std::vector<VectorF> vertices; //!< Vertices.
+  std::vector<VectorF> normals;  //!< Normals.
+  std::vector<ColorF> colors;    //!< Colors, empty if the mesh has no color.
+  std::vector<int> varray;       //!< Vertex indexes.
+  std::vector<int> narray;       //!< Normal indexes.
+  std::vector<int> carray;       //!< Color indexes.
+public:
+  //! Empty.
+  MeshF() {}
+  explicit MeshF(const Mesh&);
+  explicit MeshF(const MeshColor&);
+
+  //! Empty.
+  ~MeshF() {}
+
+  int Vertexes() const;
+  int Triangles() const;
+  bool HasColors() const;
+
+  Vector Vertex(int) const;
+  Vector Vertex(int, int) const;
+  Vector Normal(int) const;
+  Color GetColor(int) const;
+
+  const std::vector<VectorF>& Vertices() const;
+  const std::vector<VectorF>& Normals() const;
+  const std::vector<ColorF>& GetColors() const;
+  const std::vector<int>& VertexIndexes() const;
+  const std::vector<int>& NormalIndexes() const;
+  const std::vector<int>& ColorIndexes() const;
+
+  Box GetBox() const;
+  size_t Memory() const;
+
+  // Conversions
+  Mesh ToMesh() const;
+  MeshColor ToMeshColor() const;
+};
+
+//! Get the number of vertices.
+inline int MeshF::Vertexes() const
+{
+  return int(vertices.size());
+}
+
+//! Get the number of triangles.
+inline int MeshF::Triangles() const
+{
+  return int(varray.size()) / 3;
+}
+
+//! Check if the mesh has colors.
+inline bool MeshF::HasColors() const
+{
+  return !colors.empty();
+}
+
+/*!
+\brief Get a vertex.
+\param i Index.
+*/
+inline Vector MeshF::Vertex(int i) const
+{
+  return vertices[i].ToVector();
+}
+
+/*!
+\brief Get a vertex from a specific triangle.
+\param t Triangle index.
+\param v The triangle vertex: 0, 1, or 2.
+*/
+inline Vector MeshF::Vertex(int t, int v) const
+{
+  return vertices[varray[t * 3 + v]].ToVector();
+}
+
+/*!
+\brief Get a normal.
+\param i Index.
+*/
+inline Vector MeshF::Normal(int i) const
+{
+  return normals[i].ToVector();
+}
+
+/*!
+\brief Get a color.
+\param i Index.
+*/
+inline Color MeshF::GetColor(int i) const
+{
+  return colors[i].ToColor();
+}
+
+//! Return the array of vertices.
+inline const std::vector<VectorF>& MeshF::Vertices() const
+{
+  return vertices;
+}
+
+//! Return the array of normals.
+inline const std::vector<VectorF>& MeshF::Normals() const
+{
+  return normals;
+}
+
+//! Return the array of colors.
+inline const std::vector<ColorF>& MeshF::GetColors() const
+{
+  return colors;
+}
+
+//! Return the set of vertex indexes.
+inline const std::vector<int>& MeshF::VertexIndexes() const
+{
+  return varray;
+}
+
+//! Return the set of normal indexes.
+inline const std::vector<int>& MeshF::NormalIndexes() const
+{
+  return narray;
+}
+
+//! Return the set of color indexes.
+inline const std::vector<int>& MeshF::ColorIndexes() const
+{
+  return carray;
+}
@@ -0,0 +1,132 @@
+// Mesh statistics
+
+#pragma once
+
+#include "mesh.h"
+
+#include <iostream>
+
+class MeshStatistics
+{
+protected:
+  int triangles = 0;            //!< Number of triangles.
+  int degenerate = 0;           //!< Number of triangles with a null area.
+  Box box = Box::Null;          //!< Box of the vertices of the triangles.
+  double area = 0.0;            //!< Surface area.
+  double volume = 0.0;          //!< Signed enclosed volume.
+  double emin = 0.0;            //!< Minimum edge length.
+  double emax = 0.0;            //!< Maximum edge length.
+  double esum = 0.0;            //!< Sum of edge lengths.
+  double esquare = 0.0;         //!< Sum of squared edge lengths.
+  double amin = 0.0;            //!< Minimum aspect ratio.
+  double asum = 0.0;            //!< Sum of aspect ratios.
+  std::vector<int> histogram;   //!< Histogram of aspect ratios over [0,1].
+public:
+  //! Empty.
+  MeshStatistics() {}
+  explicit MeshStatistics(const Mesh&, int = 10);
+
+  //! Empty.
+  ~MeshStatistics() {}
+
+  int Triangles() const;
+  int Degenerate() const;
+  Box GetBox() const;
+
+  double Area() const;
+  double Volume() const;
+
+  // Edges
+  int Edges() const;
+  double MinEdge() const;
+  double MaxEdge() const;
+  double AverageEdge() const;
+  double EdgeDeviation() const;
+
+  // Quality
+  double MinAspect() const;
+  double AverageAspect() const;
+  const std::vector<int>& Histogram() const;
+
+  friend std::ostream& operator<<(std::ostream&, const MeshStatistics&);
+};
+
+//! Get the number of triangles.
+inline int MeshStatistics::Triangles() const
+{
+  return triangles;
+}
+
+//! Get the number of triangles with a null area, whose aspect ratio is null.
+inline int MeshStatistics::Degenerate() const
+{
+  return degenerate;
+}
+
+//! Get the box of the vertices of the triangles.
+inline Box MeshStatistics::GetBox() const
+{
+  return box;
+}
+
+//! Get the surface area.
+inline double MeshStatistics::Area() const
+{
+  return area;
+}
+
+/*!
+\brief Get the volume enclosed by the mesh.
+
+The volume is only meaningful for closed meshes, and is negative if triangles are oriented inwards.
+*/
+inline double MeshStatistics::Volume() const
+{
+  return volume;
+}
+
+/*!
+\brief Get the number of edges over which edge lengths are computed.
+
+Edges are those of every triangle, so that edges shared by two triangles are counted twice.
+*/
+inline int MeshStatistics::Edges() const
+{
+  return 3 * triangles;
+}
+
+//! Get the minimum edge length.
+inline double MeshStatistics::MinEdge() const
+{
+  return emin;
+}
+
+//! Get the maximum edge length.
+inline double MeshStatistics::MaxEdge() const
+{
+  return emax;
+}
+
+//! Get the average edge length.
+inline double MeshStatistics::AverageEdge() const
+{
+  return triangles == 0 ? 0.0 : esum / Edges();
+}
+
+//! Get the minimum aspect ratio, see Triangle::Aspect().
+inline double MeshStatistics::MinAspect() const
+{
+  return amin;
+}
+
+//! Get the average aspect ratio.
+inline double MeshStatistics::AverageAspect() const
+{
+  return triangles == 0 ? 0.0 : asum / triangles;
+}
+
+//! Get the histogram of aspect ratios, with bins of equal width over [0,1].
+inline const std::vector<int>& MeshStatistics::Histogram() const
+{
+  return histogram;
+}
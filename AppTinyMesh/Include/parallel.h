@@ -0,0 +1,181 @@
+// Parallel primitives
+
+#pragma once
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+class Parallel
+{
+public:
+  static int Threads();
+
+  template<typename T>
+  static T ExclusiveScan(std::vector<T>&);
+
+  static void RadixSort(std::vector<unsigned long long>&, std::vector<int>&);
+public:
+  static const int Grain = 1 << 16; //!< Size below which primitives run serially.
+};
+
+/*!
+\brief Return the number of threads available for parallel regions.
+*/
+inline int Parallel::Threads()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+/*!
+\brief In place exclusive prefix sum.
+
+The array is split into one contiguous chunk per thread: every thread sums its chunk,
+the partial sums are scanned serially, and every thread then rescans its chunk with its offset.
+\param a Array, replaced by its exclusive prefix sum.
+\return The sum of all the elements.
+*/
+template<typename T>
+inline T Parallel::ExclusiveScan(std::vector<T>& a)
+{
+  const int n = int(a.size());
+  const int threads = n < Grain ? 1 : Threads();
+
+  std::vector<T> sums(threads + 1, T(0));
+  int used = 1;
+
+#pragma omp parallel num_threads(threads)
+  {
+    int t = 0;
+    int nt = 1;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+    const int begin = int((long long)(n) * t / nt);
+    const int end = int((long long)(n) * (t + 1) / nt);
+
+    T s = T(0);
+    for (int i = begin; i < end; i++)
+    {
+      s += a[i];
+    }
+    sums[t + 1] = s;
+
+#pragma omp barrier
+#pragma omp single
+    {
+      used = nt;
+      for (int i = 0; i < nt; i++)
+      {
+        sums[i + 1] += sums[i];
+      }
+    }
+
+    s = sums[t];
+    for (int i = begin; i < end; i++)
+    {
+      T x = a[i];
+      a[i] = s;
+      s += x;
+    }
+  }
+  return sums[used];
+}
+
+/*!
+\brief Stable parallel least significant digit radix sort of key and value pairs.
+
+Keys are sorted by bytes, and passes over the most significant bytes that are null for
+every key are skipped. Every pass computes one histogram per thread on a contiguous chunk
+of the array, and the scatter preserves the order within and across chunks, so that the
+sort is stable and its result does not depend on the number of threads.
+\param keys Keys.
+\param values Values, permuted along with the keys.
+*/
+inline void Parallel::RadixSort(std::vector<unsigned long long>& keys, std::vector<int>& values)
+{
+  const int n = int(keys.size());
+  const int threads = n < Grain ? 1 : Threads();
+
+  // Number of significant bytes
+  unsigned long long all = 0;
+#pragma omp parallel num_threads(threads)
+  {
+    unsigned long long local = 0;
+#pragma omp for schedule(static)
+    for (int i = 0; i < n; i++)
+    {
+      local |= keys[i];
+    }
+#pragma omp critical
+    all |= local;
+  }
+  int passes = 0;
+  while (passes < 8 && (all >> (8 * passes)) != 0)
+  {
+    passes++;
+  }
+
+  std::vector<unsigned long long> tk(n);
+  std::vector<int> tv(n);
+  std::vector<int> histogram(256 * threads);
+
+  for (int pass = 0; pass < passes; pass++)
+  {
+    const int shift = 8 * pass;
+
+#pragma omp parallel num_threads(threads)
+    {
+      int t = 0;
+      int nt = 1;
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+      nt = omp_get_num_threads();
+#endif
+      const int begin = int((long long)(n) * t / nt);
+      const int end = int((long long)(n) * (t + 1) / nt);
+
+      int* h = &histogram[256 * t];
+      for (int i = 0; i < 256; i++)
+      {
+        h[i] = 0;
+      }
+      for (int i = begin; i < end; i++)
+      {
+        h[(keys[i] >> shift) & 255]++;
+      }
+
+#pragma omp barrier
+#pragma omp single
+      {
+        // Offsets in digit major, then thread order
+        int s = 0;
+        for (int d = 0; d < 256; d++)
+        {
+          for (int j = 0; j < nt; j++)
+          {
+            int x = histogram[256 * j + d];
+            histogram[256 * j + d] = s;
+            s += x;
+          }
+        }
+      }
+
+      for (int i = begin; i < end; i++)
+      {
+        int k = h[(keys[i] >> shift) & 255]++;
+        tk[k] = keys[i];
+        tv[k] = values[i];
+      }
+    }
+    keys.swap(tk);
+    values.swap(tv);
+  }
+}
@@ -68,4 +68,57 @@ inline Vector Ray::operator()(double t) const
   return c + t * n;
 }
 
+// Single precision ray, prepared for intersections with blocks of triangles
+class RayF
+{
+protected:
+  float o[3];     //!< Origin.
+  float d[3];     //!< Direction.
+  int kx, ky, kz; //!< Permutation of the axes, kz being the dominant axis of the direction.
+  float s[3];     //!< Shear and scale that map the direction to the kz axis, for watertight intersections.
+public:
+  //! Empty.
+  RayF() {}
+  explicit RayF(const Ray&);
+
+  //! Empty.
+  ~RayF() {}
+
+  friend class TriangleBlockF;
+};
+
+/*!
+\brief Creates a single precision ray.
+
+The dominant axis of the direction and the shear of the watertight intersection algorithm
+[Woop et al. 2013] are computed once for all the triangles tested against the ray.
+\param ray The ray.
+*/
+inline RayF::RayF(const Ray& ray)
+{
+  const Vector p = ray.Origin();
+  const Vector n = ray.Direction();
+  for (int k = 0; k < 3; k++)
+  {
+    o[k] = float(p[k]);
+    d[k] = float(n[k]);
+  }
+
+  const Vector a = Abs(n);
+  kz = (a[0] >= a[1] && a[0] >= a[2]) ? 0 : (a[1] >= a[2] ? 1 : 2);
+  kx = (kz + 1) % 3;
+  ky = (kx + 1) % 3;
+
+  // Keep the winding of the triangles
+  if (d[kz] < 0.0f)
+  {
+    const int t = kx;
+    kx = ky;
+    ky = t;
+  }
+  s[0] = d[kx] / d[kz];
+  s[1] = d[ky] / d[kz];
+  s[2] = 1.0f / d[kz];
+}
+
 #endif
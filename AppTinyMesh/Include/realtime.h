@@ -102,6 +102,7 @@ protected:
     GLuint indexBuffer;			//!< Mesh index buffer.
     int triangleCount;			//!< Triangle count to draw.
     float TRSMatrix[16];		//!< Translation-Rotation-Scale Matrix.
+    float NormalMatrix[9];		//!< Inverse transpose of the linear part of the Translation-Rotation-Scale Matrix.
     Box bbox;					//!< Bounding box of the mesh.
 
     MeshShading shading;		//!< Render flag.
@@ -115,6 +116,7 @@ protected:
 
     void Delete();
     void SetFrame(const Vector& position);
+    void SetFrame(const Frame& frame);
   };
 
   typedef QMap<QString, MeshGL*>::iterator MeshIterator;
@@ -151,6 +153,7 @@ public:
   void ClearAll();
 
   void UpdateMesh(const QString&, const Vector&);
+  void UpdateMesh(const QString&, const Frame&);
   void EnableMesh(const QString&);
   void DisableMesh(const QString&);
 
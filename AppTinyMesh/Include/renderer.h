@@ -0,0 +1,62 @@
+// Ray cast renderer
+
+#pragma once
+
+#include "camera.h"
+#include "meshbvh.h"
+#include "meshcolor.h"
+
+class QString;
+
+enum class RendererMaterial
+{
+  Normal = 0,
+  Color = 1,
+};
+
+class Renderer
+{
+protected:
+  std::vector<MeshColor> meshes;           //!< Meshes with their colors.
+  std::vector<MeshBVH> hierarchies;        //!< Hierarchies of the triangles of the meshes.
+  std::vector<RendererMaterial> materials; //!< Materials of the meshes.
+  Color background = Color(1.0, 1.0, 1.0); //!< Background color.
+public:
+  //! Empty.
+  Renderer() {}
+
+  //! Empty.
+  ~Renderer() {}
+
+  void AddMesh(const Mesh&, RendererMaterial = RendererMaterial::Normal);
+  void AddMesh(const MeshColor&, RendererMaterial = RendererMaterial::Color);
+  int Meshes() const;
+
+  void SetBackground(const Color&);
+
+  void Render(const Camera&, int, int, std::vector<Color>&) const;
+
+  // Images
+  static bool Save(const QString&, const std::vector<Color>&, int, int);
+  static bool SavePPM(const QString&, const std::vector<Color>&, int, int);
+  static bool SavePNG(const QString&, const std::vector<Color>&, int, int);
+protected:
+  Color Shade(int, const MeshBVHHit&, const Vector&) const;
+public:
+  static const int TileSize = 32; //!< Size of the square tiles of pixels rendered by one thread.
+};
+
+//! Get the number of meshes.
+inline int Renderer::Meshes() const
+{
+  return int(meshes.size());
+}
+
+/*!
+\brief Set the color of the pixels that do not see any mesh.
+\param c Color.
+*/
+inline void Renderer::SetBackground(const Color& c)
+{
+  background = c;
+}
@@ -0,0 +1,216 @@
+// Topology
+
+#pragma once
+
+#include <vector>
+
+class MeshTopology
+{
+protected:
+  std::vector<int> twin;      //!< Opposite half-edge, -1 for boundary and -2 for non-manifold edges.
+  std::vector<int> edge;      //!< Undirected edge index of every half-edge.
+  std::vector<int> outgoing;  //!< One outgoing half-edge per vertex, -1 for isolated vertices.
+  std::vector<char> flags;    //!< Vertex flags.
+  int edges = 0;              //!< Number of undirected edges.
+  int boundary = 0;           //!< Number of boundary edges.
+  int nonmanifold = 0;        //!< Number of non-manifold edges.
+public:
+  //! Empty.
+  MeshTopology() {}
+  explicit MeshTopology(const std::vector<int>&, int);
+
+  //! Empty.
+  ~MeshTopology() {}
+
+  // Half-edges
+  static int Next(int);
+  static int Prev(int);
+  static int Face(int);
+
+  int Twin(int) const;
+  int Edge(int) const;
+  int Swing(int) const;
+  int CounterSwing(int) const;
+  int Outgoing(int) const;
+
+  int HalfEdges() const;
+  int Edges() const;
+  int Vertexes() const;
+
+  // Boundary and non-manifold edges and vertices
+  bool IsBoundary(int) const;
+  bool IsNonManifold(int) const;
+  bool IsBoundaryVertex(int) const;
+  bool IsNonManifoldVertex(int) const;
+
+  int BoundaryEdges() const;
+  int NonManifoldEdges() const;
+  bool IsClosed() const;
+  bool IsManifold() const;
+public:
+  static const int Boundary = -1;    //!< Twin of a boundary half-edge.
+  static const int NonManifold = -2; //!< Twin of a non-manifold half-edge.
+protected:
+  static const char BoundaryVertex = 1;    //!< Vertex flag.
+  static const char NonManifoldVertex = 2; //!< Vertex flag.
+};
+
+/*!
+\brief Return the next half-edge in the same triangle.
+\param h Half-edge.
+*/
+inline int MeshTopology::Next(int h)
+{
+  return (h % 3 == 2) ? h - 2 : h + 1;
+}
+
+/*!
+\brief Return the previous half-edge in the same triangle.
+\param h Half-edge.
+*/
+inline int MeshTopology::Prev(int h)
+{
+  return (h % 3 == 0) ? h + 2 : h - 1;
+}
+
+/*!
+\brief Return the triangle of a half-edge.
+\param h Half-edge.
+*/
+inline int MeshTopology::Face(int h)
+{
+  return h / 3;
+}
+
+/*!
+\brief Return the opposite half-edge.
+\param h Half-edge.
+\return The twin half-edge, MeshTopology::Boundary or MeshTopology::NonManifold.
+*/
+inline int MeshTopology::Twin(int h) const
+{
+  return twin[h];
+}
+
+/*!
+\brief Return the index of the undirected edge of a half-edge, shared with its twin.
+\param h Half-edge.
+*/
+inline int MeshTopology::Edge(int h) const
+{
+  return edge[h];
+}
+
+/*!
+\brief Return the next outgoing half-edge around the origin of a half-edge.
+\param h Half-edge.
+\return The half-edge, or a negative value if the traversal reaches a boundary or non-manifold edge.
+*/
+inline int MeshTopology::Swing(int h) const
+{
+  return twin[h] < 0 ? twin[h] : Next(twin[h]);
+}
+
+/*!
+\brief Return the previous outgoing half-edge around the origin of a half-edge.
+\param h Half-edge.
+\return The half-edge, or a negative value if the traversal reaches a boundary or non-manifold edge.
+\sa MeshTopology::Swing()
+*/
+inline int MeshTopology::CounterSwing(int h) const
+{
+  return twin[Prev(h)];
+}
+
+/*!
+\brief Return an outgoing half-edge of a vertex.
+
+For boundary vertices, this is the first half-edge of the fan so that iterating
+with MeshTopology::Swing() visits all the triangles of the fan.
+\param v Vertex index.
+\return The half-edge, -1 for isolated vertices.
+*/
+inline int MeshTopology::Outgoing(int v) const
+{
+  return outgoing[v];
+}
+
+//! Return the number of half-edges, which is three times the number of triangles.
+inline int MeshTopology::HalfEdges() const
+{
+  return int(twin.size());
+}
+
+//! Return the number of undirected edges.
+inline int MeshTopology::Edges() const
+{
+  return edges;
+}
+
+//! Return the number of vertices.
+inline int MeshTopology::Vertexes() const
+{
+  return int(outgoing.size());
+}
+
+/*!
+\brief Check if a half-edge lies on the boundary.
+\param h Half-edge.
+*/
+inline bool MeshTopology::IsBoundary(int h) const
+{
+  return twin[h] == Boundary;
+}
+
+/*!
+\brief Check if a half-edge is non-manifold, i.e. shared by more than two triangles or inconsistently oriented.
+\param h Half-edge.
+*/
+inline bool MeshTopology::IsNonManifold(int h) const
+{
+  return twin[h] == NonManifold;
+}
+
+/*!
+\brief Check if a vertex lies on the boundary.
+\param v Vertex index.
+*/
+inline bool MeshTopology::IsBoundaryVertex(int v) const
+{
+  return (flags[v] & BoundaryVertex) != 0;
+}
+
+/*!
+\brief Check if a vertex is non-manifold.
+
+This is the case if it is adjacent to a non-manifold edge or if its triangles do not form a single fan.
+\param v Vertex index.
+*/
+inline bool MeshTopology::IsNonManifoldVertex(int v) const
+{
+  return (flags[v] & NonManifoldVertex) != 0;
+}
+
+//! Return the number of boundary edges.
+inline int MeshTopology::BoundaryEdges() const
+{
+  return boundary;
+}
+
+//! Return the number of non-manifold edges.
+inline int MeshTopology::NonManifoldEdges() const
+{
+  return nonmanifold;
+}
+
+//! Check if the mesh has no boundary edge.
+inline bool MeshTopology::IsClosed() const
+{
+  return boundary == 0;
+}
+
+//! Check if the mesh has no non-manifold edge.
+inline bool MeshTopology::IsManifold() const
+{
+  return nonmanifold == 0;
+}
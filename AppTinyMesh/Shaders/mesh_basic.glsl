@@ -8,6 +8,7 @@ in vec3 color;
 uniform mat4 ModelViewMatrix;
 uniform mat4 ProjectionMatrix;
 uniform mat4 TRSMatrix;
+uniform mat3 NormalMatrix;
 
 out vec3 fragNormal;
 out vec3 fragVertex;
@@ -17,7 +18,7 @@ void main(void)
 {
 	mat4 MVP      = ProjectionMatrix * ModelViewMatrix;
 	gl_Position   = MVP * TRSMatrix * (vec4(vertex, 1.0)); 
-	fragNormal	  = (TRSMatrix * vec4(normalize(normal), 0.0f)).xyz;
+	fragNormal	  = normalize(NormalMatrix * normal);
 	fragVertex 	  = vertex;
 	fragColor	  = color;
 } 
@@ -3,6 +3,19 @@
 // Self include
 #include "box.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BOX_SSE2
+#endif
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define BOX_AVX512
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define BOX_AVX
+#endif
+
 /*!
 \class Box box.h
 \brief An axis aligned box.
@@ -89,25 +102,54 @@ Box::Box(double r)
 
 /*!
 \brief Creates the bounding box of a set of points.
+
+The minimum and maximum are computed in a single pass over the array. With SIMD instructions,
+the coordinates of two points are loaded as three pairs (x,y), (z,x) and (y,z), and every pair
+has its own minimum and maximum, which are merged at the end.
 \param v Array of vertices.
 */
 Box::Box(const std::vector<Vector>& v)
 {
-  for (int j = 0; j < 3; j++)
+  a = v.at(0);
+  b = v.at(0);
+
+  const int n = int(v.size());
+  int i = 1;
+#ifdef BOX_SSE2
+  if (n >= 3)
   {
-    a[j] = v.at(0)[j];
-    b[j] = v.at(0)[j];
-    for (int i = 1; i < v.size(); i++)
+    // Vectors store their three coordinates contiguously
+    const double* p = (const double*)(v.data()) + 3;
+    __m128d a0 = _mm_loadu_pd(p), a1 = _mm_loadu_pd(p + 2), a2 = _mm_loadu_pd(p + 4);
+    __m128d b0 = a0, b1 = a1, b2 = a2;
+    for (i = 3; i + 2 <= n; i += 2)
     {
-      if (v.at(i)[j] < a[j])
-      {
-        a[j] = v.at(i)[j];
-      }
-      if (v.at(i)[j] > b[j])
-      {
-        b[j] = v.at(i)[j];
-      }
+      p = (const double*)(v.data()) + 3 * i;
+      const __m128d c0 = _mm_loadu_pd(p);
+      const __m128d c1 = _mm_loadu_pd(p + 2);
+      const __m128d c2 = _mm_loadu_pd(p + 4);
+      a0 = _mm_min_pd(a0, c0);
+      a1 = _mm_min_pd(a1, c1);
+      a2 = _mm_min_pd(a2, c2);
+      b0 = _mm_max_pd(b0, c0);
+      b1 = _mm_max_pd(b1, c1);
+      b2 = _mm_max_pd(b2, c2);
     }
+    alignas(16) double x[6][2];
+    _mm_store_pd(x[0], a0);
+    _mm_store_pd(x[1], a1);
+    _mm_store_pd(x[2], a2);
+    _mm_store_pd(x[3], b0);
+    _mm_store_pd(x[4], b1);
+    _mm_store_pd(x[5], b2);
+    a = Vector::Min(a, Vector(Math::Min(x[0][0], x[1][1]), Math::Min(x[0][1], x[2][0]), Math::Min(x[1][0], x[2][1])));
+    b = Vector::Max(b, Vector(Math::Max(x[3][0], x[4][1]), Math::Max(x[3][1], x[5][0]), Math::Max(x[4][0], x[5][1])));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    a = Vector::Min(a, v[i]);
+    b = Vector::Max(b, v[i]);
   }
 }
 
@@ -174,3 +216,115 @@ void Box::Scale(double s)
     b = t;
   }
 }
+
+/*!
+\brief Compute the intersection between a ray and the box.
+\param ray The ray.
+\param tmin, tmax Entry and exit distances along the ray, the entry distance is negative if the origin is inside the box.
+\return True if the ray hits the box.
+*/
+bool Box::Intersect(const Ray& ray, double& tmin, double& tmax) const
+{
+  tmin = -Math::Infinity;
+  tmax = Math::Infinity;
+  return Intersect(ray.Origin(), ray.Direction().Inverse(), tmin, tmax) && tmax >= 0.0;
+}
+
+/*!
+\class BoxBlock box.h
+\brief A block of boxes stored as structure of arrays, for testing one ray against several boxes at once.
+
+The block is processed in a single pass of eight lanes with AVX-512, two passes of four lanes
+with AVX, and four passes of two lanes with SSE2. The near and far planes are selected once
+for all the lanes from the sign of the inverse of the direction, as in Box::Intersect().
+\code
+BoxBlock block;
+block.Gather(boxes, 0, 8);
+alignas(64) double t[BoxBlock::Width];
+int hits = block.Intersect(ray.Origin(), ray.Direction().Inverse(), 0.0, Math::Infinity, t);
+for (int l = 0; l < block.Size(); l++)
+{
+  if (hits & (1 << l)) // Box l is entered at distance t[l]
+  {
+  }
+}
+\endcode
+*/
+
+/*!
+\brief Intersect a ray with all the boxes of the block.
+\param o Origin of the ray.
+\param inv Inverse of the direction of the ray.
+\param tmin, tmax Interval along the ray.
+\param t Array of BoxBlock::Width entry distances, clipped to the interval, only meaningful for the lanes that are hit.
+\return The mask of the lanes whose box is hit, bit l being set for lane l.
+*/
+int BoxBlock::Intersect(const Vector& o, const Vector& inv, double tmin, double tmax, double* t) const
+{
+  int s[3];
+  for (int k = 0; k < 3; k++)
+  {
+    s[k] = inv[k] < 0.0 ? 1 : 0;
+  }
+
+  // Undefined distances are ignored by taking the interval bound as the second operand of min and max
+  int mask = 0;
+#if defined(BOX_AVX512)
+  __m512d t0 = _mm512_set1_pd(tmin);
+  __m512d t1 = _mm512_set1_pd(tmax);
+  for (int k = 0; k < 3; k++)
+  {
+    const __m512d ok = _mm512_set1_pd(o[k]);
+    const __m512d ik = _mm512_set1_pd(inv[k]);
+    t0 = _mm512_max_pd(_mm512_mul_pd(_mm512_sub_pd(_mm512_load_pd(c[s[k]][k]), ok), ik), t0);
+    t1 = _mm512_min_pd(_mm512_mul_pd(_mm512_sub_pd(_mm512_load_pd(c[1 - s[k]][k]), ok), ik), t1);
+  }
+  mask = int(_mm512_cmp_pd_mask(t0, t1, _CMP_LE_OQ));
+  _mm512_storeu_pd(t, t0);
+#elif defined(BOX_AVX)
+  for (int h = 0; h < Width; h += 4)
+  {
+    __m256d t0 = _mm256_set1_pd(tmin);
+    __m256d t1 = _mm256_set1_pd(tmax);
+    for (int k = 0; k < 3; k++)
+    {
+      const __m256d ok = _mm256_set1_pd(o[k]);
+      const __m256d ik = _mm256_set1_pd(inv[k]);
+      t0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(c[s[k]][k] + h), ok), ik), t0);
+      t1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(c[1 - s[k]][k] + h), ok), ik), t1);
+    }
+    mask |= _mm256_movemask_pd(_mm256_cmp_pd(t0, t1, _CMP_LE_OQ)) << h;
+    _mm256_storeu_pd(t + h, t0);
+  }
+#elif defined(BOX_SSE2)
+  for (int h = 0; h < Width; h += 2)
+  {
+    __m128d t0 = _mm_set1_pd(tmin);
+    __m128d t1 = _mm_set1_pd(tmax);
+    for (int k = 0; k < 3; k++)
+    {
+      const __m128d ok = _mm_set1_pd(o[k]);
+      const __m128d ik = _mm_set1_pd(inv[k]);
+      t0 = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(c[s[k]][k] + h), ok), ik), t0);
+      t1 = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(c[1 - s[k]][k] + h), ok), ik), t1);
+    }
+    mask |= _mm_movemask_pd(_mm_cmple_pd(t0, t1)) << h;
+    _mm_storeu_pd(t + h, t0);
+  }
+#else
+  for (int l = 0; l < Width; l++)
+  {
+    double t0 = tmin, t1 = tmax;
+    for (int k = 0; k < 3; k++)
+    {
+      const double tn = (c[s[k]][k][l] - o[k]) * inv[k];
+      const double tf = (c[1 - s[k]][k][l] - o[k]) * inv[k];
+      t0 = tn > t0 ? tn : t0;
+      t1 = tf < t1 ? tf : t1;
+    }
+    mask |= (t0 <= t1 ? 1 : 0) << l;
+    t[l] = t0;
+  }
+#endif
+  return mask & ((1 << n) - 1);
+}
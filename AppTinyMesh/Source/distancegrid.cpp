@@ -0,0 +1,295 @@
+// Signed distance field sampled on a grid
+
+#include "distancegrid.h"
+#include "meshdistance.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+/*!
+\class DistanceGrid distancegrid.h
+\brief Signed distance field of a mesh sampled on a regular grid, which converts meshes into implicit surfaces.
+
+Samples are spaced evenly along all the axes, and the field is interpolated trilinearly, so that the
+mesh can be combined with other fields and polygonized again.
+\code
+DistanceGrid grid(mesh, Box(Vector(-1.2), Vector(1.2)), 128);
+Mesh remeshed;
+grid.Polygonize(128, remeshed, grid.GetBox());
+\endcode
+
+The grid is computed in two steps so that the cost remains proportional to the number of samples.
+Samples closer to the mesh than a narrow band of DistanceGrid::Band samples get their exact signed
+distance from a MeshDistance query bounded by the width of the band. Only the bricks of samples
+overlapped by the boxes of the triangles grown by the band are processed, in parallel.
+
+Distances are then propagated outward by solving the eikonal equation with the fast sweeping method,
+see Zhao, <i>A fast sweeping method for eikonal equations</i>, Mathematics of Computation, 2005. Every
+one of the eight sweeps processes the rows of samples along x by diagonals j+k=l in order, and the rows of
+a diagonal are swept in parallel as they only depend on the rows of the previous diagonal, which gives the
+same result as a sequential sweep while keeping the accesses along the rows contiguous.
+
+Distances are stored in single precision.
+*/
+
+/*!
+\brief Create the signed distance field of a mesh.
+
+The mesh should be closed and oriented counter-clockwise seen from the outside, as the meshes created
+by AnalyticScalarField::Polygonize(), so that the field is negative inside, see MeshDistance.
+\param mesh The mesh.
+\param b Box of the grid.
+\param n Number of samples along the largest side of the box, at least two along every side.
+*/
+DistanceGrid::DistanceGrid(const Mesh& mesh, const Box& b, int n) : box(b)
+{
+  const Vector size = box.Size();
+  h = Math::Max(size[0], size[1], size[2]) / (n < 2 ? 1 : n - 1);
+  nx = int(Math::Max(ceil(size[0] / h - 1e-6), 1.0)) + 1;
+  ny = int(Math::Max(ceil(size[1] / h - 1e-6), 1.0)) + 1;
+  nz = int(Math::Max(ceil(size[2] / h - 1e-6), 1.0)) + 1;
+  field.assign(size_t(nx) * ny * nz, float(Math::Infinity));
+
+  // Bricks overlapped by the boxes of the triangles grown by the band
+  const double band = Band * h;
+  const int bx = (nx + Brick - 1) / Brick;
+  const int by = (ny + Brick - 1) / Brick;
+  const int bz = (nz + Brick - 1) / Brick;
+  std::vector<char> active(size_t(bx) * by * bz, 0);
+  const int dims[3] = { nx, ny, nz };
+  for (int t = 0; t < mesh.Triangles(); t++)
+  {
+    const Box tb = mesh.GetTriangle(t).GetBox();
+    int lo[3], hi[3];
+    for (int k = 0; k < 3; k++)
+    {
+      const double a = floor((tb[0][k] - band - box[0][k]) / h);
+      const double c = ceil((tb[1][k] + band - box[0][k]) / h);
+      lo[k] = a < 0.0 ? 0 : (a > dims[k] - 1 ? dims[k] - 1 : int(a));
+      hi[k] = c < 0.0 ? 0 : (c > dims[k] - 1 ? dims[k] - 1 : int(c));
+      lo[k] /= Brick;
+      hi[k] /= Brick;
+    }
+    for (int z = lo[2]; z <= hi[2]; z++)
+    {
+      for (int y = lo[1]; y <= hi[1]; y++)
+      {
+        for (int x = lo[0]; x <= hi[0]; x++)
+        {
+          active[x + bx * (y + by * size_t(z))] = 1;
+        }
+      }
+    }
+  }
+  std::vector<int> bricks;
+  for (int i = 0; i < int(active.size()); i++)
+  {
+    if (active[i])
+      bricks.push_back(i);
+  }
+
+  // Exact signed distances in the band
+  const MeshDistance distance(mesh);
+  std::vector<char> fixed(field.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int q = 0; q < int(bricks.size()); q++)
+  {
+    const int x0 = (bricks[q] % bx) * Brick;
+    const int y0 = (bricks[q] / bx % by) * Brick;
+    const int z0 = (bricks[q] / bx / by) * Brick;
+    for (int k = z0; k < z0 + Brick && k < nz; k++)
+    {
+      for (int j = y0; j < y0 + Brick && j < ny; j++)
+      {
+        for (int i = x0; i < x0 + Brick && i < nx; i++)
+        {
+          const double d = distance.Signed(Vertex(i, j, k), band);
+          if (fabs(d) <= band)
+          {
+            field[Index(i, j, k)] = float(d);
+            fixed[Index(i, j, k)] = 1;
+          }
+        }
+      }
+    }
+  }
+
+  Sweep(fixed);
+}
+
+/*!
+\brief Get the neighbor of a sample with the smallest distance along an axis.
+\param f Sample.
+\param step Offset of the neighbors.
+\param lower, upper Existence of the lower and upper neighbors.
+\return The signed distance at the neighbor, infinite if none.
+*/
+static float DistanceGridNeighbor(const float* f, int step, bool lower, bool upper)
+{
+  const float a = lower ? f[-step] : float(Math::Infinity);
+  const float b = upper ? f[step] : float(Math::Infinity);
+  return fabs(a) < fabs(b) ? a : b;
+}
+
+/*!
+\brief Solve the upwind discretization of the eikonal equation at a sample.
+\param a, b, c Distances at the closest neighbors along the three axes, sorted in increasing order.
+\param h Spacing of the samples.
+*/
+static double DistanceGridSolve(double a, double b, double c, double h)
+{
+  double u = a + h;
+  if (u > b)
+  {
+    u = 0.5 * (a + b + sqrt(2.0 * h * h - (a - b) * (a - b)));
+    if (u > c)
+    {
+      const double s = a + b + c;
+      u = (s + sqrt(Math::Max(s * s - 3.0 * (a * a + b * b + c * c - h * h), 0.0))) / 3.0;
+    }
+  }
+  return u;
+}
+
+/*!
+\brief Propagate the distances of the band to the other samples with eight sweeps.
+
+Samples are updated from their closest neighbor along every axis, and take the sign of the closest one.
+\param fixed Samples of the band, which are not updated.
+*/
+void DistanceGrid::Sweep(const std::vector<char>& fixed)
+{
+  const int sy = nx;
+  const int sz = nx * ny;
+  for (int s = 0; s < 8; s++)
+  {
+    const bool fx = (s & 1) != 0;
+    const bool fy = (s & 2) != 0;
+    const bool fz = (s & 4) != 0;
+
+    // Rows along x on the diagonals j+k=l, which only depend on the rows of the previous diagonal
+    for (int l = 0; l <= ny + nz - 2; l++)
+    {
+      const int j0 = l - (nz - 1) > 0 ? l - (nz - 1) : 0;
+      const int j1 = l < ny - 1 ? l : ny - 1;
+#pragma omp parallel for schedule(static) if((j1 - j0 + 1) * nx >= Parallel::Grain / 16)
+      for (int j = j0; j <= j1; j++)
+      {
+        const int y = fy ? ny - 1 - j : j;
+        const int z = fz ? nz - 1 - (l - j) : l - j;
+        float* row = &field[Index(0, y, z)];
+        const char* done = &fixed[Index(0, y, z)];
+        for (int i = 0; i < nx; i++)
+        {
+          const int x = fx ? nx - 1 - i : i;
+          if (done[x])
+            continue;
+          float* f = row + x;
+          const float dx = DistanceGridNeighbor(f, 1, x > 0, x < nx - 1);
+          const float dy = DistanceGridNeighbor(f, sy, y > 0, y < ny - 1);
+          const float dz = DistanceGridNeighbor(f, sz, z > 0, z < nz - 1);
+
+          // Sorted distances
+          double a = fabs(dx), b = fabs(dy), c = fabs(dz);
+          float sign = dx;
+          if (b < a)
+          {
+            std::swap(a, b);
+            sign = dy;
+          }
+          if (c < a)
+          {
+            std::swap(a, c);
+            sign = dz;
+          }
+          if (c < b)
+            std::swap(b, c);
+
+          // The solution is larger than the closest distance
+          if (a >= fabs(*f))
+            continue;
+
+          const double u = DistanceGridSolve(a, b, c, h);
+          if (u < fabs(*f))
+          {
+            *f = sign < 0.0f ? -float(u) : float(u);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+\brief Get the cell of the grid that contains a point, which is clamped to the grid.
+\param p Point.
+\param i, j, k Returned integer coordinates of the lower sample of the cell.
+\param u, v, w Returned coordinates of the point in the cell.
+\return The vector from the closest point of the grid to the point, null inside the grid.
+*/
+Vector DistanceGrid::Cell(const Vector& p, int& i, int& j, int& k, double& u, double& v, double& w) const
+{
+  const Vector q = (p - box[0]) / h;
+  const double x = Math::Clamp(q[0], 0.0, nx - 1);
+  const double y = Math::Clamp(q[1], 0.0, ny - 1);
+  const double z = Math::Clamp(q[2], 0.0, nz - 1);
+  i = int(x) < nx - 2 ? int(x) : nx - 2;
+  j = int(y) < ny - 2 ? int(y) : ny - 2;
+  k = int(z) < nz - 2 ? int(z) : nz - 2;
+  u = x - i;
+  v = y - j;
+  w = z - k;
+  return h * Vector(q[0] - x, q[1] - y, q[2] - z);
+}
+
+/*!
+\brief Compute the value of the field, interpolated trilinearly.
+
+Outside of the grid, the distance to the grid is added to the value at the closest point of the grid.
+\param p Point.
+*/
+double DistanceGrid::Value(const Vector& p) const
+{
+  int i, j, k;
+  double u, v, w;
+  const Vector o = Cell(p, i, j, k, u, v, w);
+
+  const float* f = &field[Index(i, j, k)];
+  const int dy = nx;
+  const int dz = nx * ny;
+  const double x00 = (1.0 - u) * f[0] + u * f[1];
+  const double x10 = (1.0 - u) * f[dy] + u * f[dy + 1];
+  const double x01 = (1.0 - u) * f[dz] + u * f[dz + 1];
+  const double x11 = (1.0 - u) * f[dz + dy] + u * f[dz + dy + 1];
+  const double value = (1.0 - w) * ((1.0 - v) * x00 + v * x10) + w * ((1.0 - v) * x01 + v * x11);
+  return value + Norm(o);
+}
+
+/*!
+\brief Compute the gradient of the field, which is the derivative of the trilinear interpolation.
+\param p Point.
+*/
+Vector DistanceGrid::Gradient(const Vector& p) const
+{
+  int i, j, k;
+  double u, v, w;
+  const Vector o = Cell(p, i, j, k, u, v, w);
+
+  const float* f = &field[Index(i, j, k)];
+  const int dy = nx;
+  const int dz = nx * ny;
+
+  // Differences along every axis, interpolated along the two other axes
+  const double gx = (1.0 - w) * ((1.0 - v) * (f[1] - f[0]) + v * (f[dy + 1] - f[dy])) + w * ((1.0 - v) * (f[dz + 1] - f[dz]) + v * (f[dz + dy + 1] - f[dz + dy]));
+  const double gy = (1.0 - w) * ((1.0 - u) * (f[dy] - f[0]) + u * (f[dy + 1] - f[1])) + w * ((1.0 - u) * (f[dz + dy] - f[dz]) + u * (f[dz + dy + 1] - f[dz + 1]));
+  const double gz = (1.0 - v) * ((1.0 - u) * (f[dz] - f[0]) + u * (f[dz + 1] - f[1])) + v * ((1.0 - u) * (f[dz + dy] - f[dy]) + u * (f[dz + dy + 1] - f[dy + 1]));
+  Vector g = Vector(gx, gy, gz) / h;
+
+  // Distance to the grid outside of the grid
+  const double d = Norm(o);
+  if (d > 0.0)
+  {
+    g += o / d;
+  }
+  return g;
+}
@@ -0,0 +1,150 @@
+// Frame
+
+// Self include
+#include "mathematics.h"
+
+#include <iostream>
+
+/*!
+\class Frame mathematics.h
+\brief Affine transformations in three dimensions.
+
+The transformation is stored as a 3x4 matrix whose first three columns are the images of
+the axes and whose last column is the translation. Points are transformed with Frame::Transform(),
+vectors with Frame::TransformVector(), and normals with the inverse transpose of the linear part,
+which is computed once by Frame::NormalFrame():
+\code
+Frame f = Frame::Translation(Vector(1.0, 0.0, 0.0)) * Frame::Rotation(Vector::Z, Math::DegreeToRadian(30.0));
+Vector p = f.Transform(Vector(1.0, 2.0, 3.0)); // Rotate, then translate
+Frame nf = f.NormalFrame();
+Vector n = Normalized(nf.TransformVector(Vector::Z));
+\endcode
+*/
+
+const Frame Frame::Id; //!< Identity.
+
+/*!
+\brief Compute the inverse of the transformation.
+
+The linear part is inverted with its adjugate, the frame should not be singular.
+*/
+Frame Frame::Inverse() const
+{
+  const double d = 1.0 / Determinant();
+
+  Frame f;
+  f.r[0][0] = (r[1][1] * r[2][2] - r[1][2] * r[2][1]) * d;
+  f.r[0][1] = (r[0][2] * r[2][1] - r[0][1] * r[2][2]) * d;
+  f.r[0][2] = (r[0][1] * r[1][2] - r[0][2] * r[1][1]) * d;
+  f.r[1][0] = (r[1][2] * r[2][0] - r[1][0] * r[2][2]) * d;
+  f.r[1][1] = (r[0][0] * r[2][2] - r[0][2] * r[2][0]) * d;
+  f.r[1][2] = (r[0][2] * r[1][0] - r[0][0] * r[1][2]) * d;
+  f.r[2][0] = (r[1][0] * r[2][1] - r[1][1] * r[2][0]) * d;
+  f.r[2][1] = (r[0][1] * r[2][0] - r[0][0] * r[2][1]) * d;
+  f.r[2][2] = (r[0][0] * r[1][1] - r[0][1] * r[1][0]) * d;
+
+  // Translation
+  for (int i = 0; i < 3; i++)
+  {
+    f.r[i][3] = -(f.r[i][0] * r[0][3] + f.r[i][1] * r[1][3] + f.r[i][2] * r[2][3]);
+  }
+  return f;
+}
+
+/*!
+\brief Compute the frame that transforms normals, i.e. the inverse transpose of the linear part, without translation.
+
+Normals should be normalized after the transformation. The matrix of cofactors is returned
+as is for singular transformations.
+*/
+Frame Frame::NormalFrame() const
+{
+  Frame f(Vector(0.0));
+  for (int i = 0; i < 3; i++)
+  {
+    const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; j++)
+    {
+      const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+      f.r[i][j] = r[i1][j1] * r[i2][j2] - r[i1][j2] * r[i2][j1];
+    }
+  }
+
+  // The matrix of cofactors is the inverse transpose scaled by the determinant
+  const double d = Determinant();
+  if (d != 0.0)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        f.r[i][j] /= d;
+      }
+    }
+  }
+  return f;
+}
+
+/*!
+\brief Compose two transformations, the right one is applied first.
+\param a, b Frames.
+*/
+Frame operator*(const Frame& a, const Frame& b)
+{
+  Frame f;
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      f.r[i][j] = a.r[i][0] * b.r[0][j] + a.r[i][1] * b.r[1][j] + a.r[i][2] * b.r[2][j] + (j == 3 ? a.r[i][3] : 0.0);
+    }
+  }
+  return f;
+}
+
+/*!
+\brief Create a translation.
+\param t Translation.
+*/
+Frame Frame::Translation(const Vector& t)
+{
+  return Frame(t);
+}
+
+/*!
+\brief Create a rotation around an axis through the origin.
+\param axis Axis, should be normalized.
+\param angle Angle in radian.
+*/
+Frame Frame::Rotation(const Vector& axis, double angle)
+{
+  const double c = cos(angle);
+  const double s = sin(angle);
+  const double t = 1.0 - c;
+  const double x = axis[0], y = axis[1], z = axis[2];
+
+  return Frame(Vector(t * x * x + c, t * x * y + s * z, t * x * z - s * y),
+    Vector(t * x * y - s * z, t * y * y + c, t * y * z + s * x),
+    Vector(t * x * z + s * y, t * y * z - s * x, t * z * z + c),
+    Vector(0.0));
+}
+
+/*!
+\brief Create a scaling.
+\param s Scaling factors along the axes.
+*/
+Frame Frame::Scaling(const Vector& s)
+{
+  return Frame(Vector(s[0], 0.0, 0.0), Vector(0.0, s[1], 0.0), Vector(0.0, 0.0, s[2]), Vector(0.0));
+}
+
+/*!
+\brief Overloaded.
+\param s Stream.
+\param f %Frame.
+*/
+std::ostream& operator<<(std::ostream& s, const Frame& f)
+{
+  s << "Frame(" << f.Column(0) << ',' << f.Column(1) << ',' << f.Column(2) << ',' << f.Column(3) << ')';
+  return s;
+}
@@ -21,6 +21,9 @@ double AnalyticScalarField::Value(const Vector& p) const
 /*!
 \brief Compute the polygonal mesh approximating the implicit surface.
 
+Triangles are oriented counter-clockwise seen from the outside, where the field is positive, so that
+their normals agree with the normals at the vertices.
+
 \param box %Box defining the region that will be polygonized.
 \param n Discretization parameter.
 \param g Returned geometry.
@@ -207,11 +210,13 @@ void AnalyticScalarField::Polygonize(int n, Mesh& g, const Box& box, const doubl
           e[10] = ez[i * ny + (j + 1)];
           e[11] = ez[(i + 1) * ny + (j + 1)];
 
+          // Triangles of the table are clockwise seen from the positive side of the field, they are reversed
+          // so that they are counter-clockwise seen from the outside
           for (int h = 0; TriangleTable[cubeindex][h] != -1; h += 3)
           {
             triangle.push_back(e[TriangleTable[cubeindex][h + 0]]);
-            triangle.push_back(e[TriangleTable[cubeindex][h + 1]]);
             triangle.push_back(e[TriangleTable[cubeindex][h + 2]]);
+            triangle.push_back(e[TriangleTable[cubeindex][h + 1]]);
           }
         }
       }
@@ -238,7 +243,7 @@ void AnalyticScalarField::Polygonize(int n, Mesh& g, const Box& box, const doubl
 
   std::vector<int> normals = triangle;
 
-  g = Mesh(vertex, normal, triangle, normals);
+  g = Mesh(std::move(vertex), std::move(normal), std::move(triangle), std::move(normals));
 }
 
 /*!
@@ -277,6 +282,97 @@ Vector AnalyticScalarField::Dichotomy(Vector a, Vector b, double va, double vb,
 }
 
 
+/*!
+\brief Compute the Lipschitz constant of the field.
+
+The constant bounds the norm of the gradient, so that the distance to the surface is greater than
+the absolute value of the field divided by the constant. The default field is a signed distance.
+*/
+double AnalyticScalarField::Lipschitz() const
+{
+  return 1.0;
+}
+
+/*!
+\brief Compute the first intersection between a ray and the implicit surface with sphere tracing [Hart 1996].
+
+The ray steps by the value of the field divided by its Lipschitz constant, which is a distance
+to the surface, and at least by the precision, until the field changes sign. The intersection
+is then refined with Dichotomy() between the last two points.
+
+Steps may be over-relaxed by a factor between 1 and 2 [Keinert et al. 2014]. An over-relaxed
+step whose empty sphere does not overlap the sphere of the previous point may have skipped the
+surface, and is replaced by a regular step, after which relaxation is disabled.
+\param ray The ray.
+\param t Intersection depth.
+\param tmax Maximum distance.
+\param relaxation Relaxation factor, no relaxation if 1.
+\param epsilon Precision.
+*/
+bool AnalyticScalarField::Intersect(const Ray& ray, double& t, double tmax, double relaxation, const double& epsilon) const
+{
+  const double k = Lipschitz();
+  double omega = Math::Clamp(relaxation, 1.0, 2.0);
+
+  double ta = 0.0;
+  double va = Value(ray(ta));
+  double ra = fabs(va) / k;
+  for (int i = 0; i < Steps && ta < tmax; i++)
+  {
+    const double tb = Math::Min(ta + Math::Max(omega * ra, epsilon), tmax);
+    const double vb = Value(ray(tb));
+
+    // Straddling points
+    if ((va > 0.0) != (vb > 0.0))
+    {
+      const Vector p = Dichotomy(ray(ta), ray(tb), va, vb, tb - ta, epsilon);
+      t = (p - ray.Origin()) * ray.Direction();
+      return true;
+    }
+
+    const double rb = fabs(vb) / k;
+    if (omega > 1.0 && ra + rb < tb - ta)
+    {
+      omega = 1.0;
+      continue;
+    }
+    ta = tb;
+    va = vb;
+    ra = rb;
+  }
+  return false;
+}
+
+/*!
+\brief Compute the first intersections between a set of rays and the implicit surface, in parallel.
+\sa Intersect(const Ray&, double&, double, double, const double&) const
+\param rays Set of rays.
+\param t Intersection depths, infinite for the rays that miss the surface.
+\param tmax Maximum distance.
+\param relaxation Relaxation factor.
+\param epsilon Precision.
+\return The number of rays intersecting the surface.
+*/
+int AnalyticScalarField::Intersect(const std::vector<Ray>& rays, std::vector<double>& t, double tmax, double relaxation, const double& epsilon) const
+{
+  const int n = int(rays.size());
+  t.resize(n);
+  int hits = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:hits)
+  for (int i = 0; i < n; i++)
+  {
+    if (Intersect(rays[i], t[i], tmax, relaxation, epsilon))
+    {
+      hits++;
+    }
+    else
+    {
+      t[i] = Math::Infinity;
+    }
+  }
+  return hits;
+}
+
 /*!
 \brief Compute the gradient of the field.
 \param p Point.
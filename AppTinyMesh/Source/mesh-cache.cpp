@@ -0,0 +1,273 @@
+// Vertex cache
+
+#include "mesh.h"
+
+#include <algorithm>
+
+/*!
+\brief Compute the average cache miss ratio (ACMR) of the triangles, i.e. the number of vertices
+transformed per triangle when rendered with a post-transform vertex cache.
+
+The cache is simulated as a first-in first-out queue. The ratio lies between 0.5 for an ideal
+ordering of a large mesh and 3 for the worst ordering.
+\param cache Size of the cache.
+*/
+double Mesh::CacheMissRatio(int cache) const
+{
+  const int nt = Triangles();
+  if (nt == 0)
+    return 0.0;
+
+  // Time at which the vertices entered the cache
+  std::vector<int> time(Vertexes(), -cache - 1);
+  int s = 0;
+  for (int i = 0; i < nt * 3; i++)
+  {
+    const int v = varray[i];
+    if (s - time[v] > cache)
+    {
+      time[v] = s++;
+    }
+  }
+  return double(s) / double(nt);
+}
+
+/*!
+\brief Reorder the triangles for the post-transform vertex cache, and optionally to reduce overdraw,
+then renumber the vertices in the order of their first use.
+
+Triangles are ordered with the Tipsify algorithm [Sander et al. 2007], which fans around vertices
+and selects the next fanning vertex among the ones that are still in the cache, in linear time.
+
+To reduce overdraw, the sequence is split into clusters at the dead ends of the traversal and
+wherever the cache miss ratio of the current cluster falls below the overall ratio, provided that
+the cluster has at least eight times as many triangles as the size of the cache, which keeps most
+of the locality. Clusters are then sorted so that the ones facing away from the center of the
+mesh come first, which tends to draw occluders before occluded triangles. Orders within clusters
+are kept.
+
+Vertices that are not referenced by any triangle are moved at the end.
+\param cache Size of the cache.
+\param overdraw Sort clusters of triangles for reduced overdraw.
+\sa Mesh::CacheMissRatio()
+*/
+void Mesh::OptimizeCache(int cache, bool overdraw)
+{
+  const int nv = Vertexes();
+  const int nt = Triangles();
+  if (nt == 0)
+    return;
+
+  std::vector<int> offset;
+  std::vector<int> around;
+  VertexTriangles(offset, around);
+
+  // Live triangles of the vertices, and time at which they entered the cache
+  std::vector<int> live(nv);
+  for (int i = 0; i < nv; i++)
+  {
+    live[i] = offset[i + 1] - offset[i];
+  }
+  std::vector<int> time(nv, -cache - 1);
+  std::vector<char> emitted(nt, 0);
+
+  std::vector<int> order;
+  order.reserve(nt);
+  std::vector<int> cluster;
+  std::vector<int> dead;
+  std::vector<int> candidates;
+
+  int s = cache + 1;
+  int cursor = 0;
+  int f = 0;
+  cluster.push_back(0);
+  while (f >= 0)
+  {
+    // Fan around the vertex
+    candidates.clear();
+    for (int k = offset[f]; k < offset[f + 1]; k++)
+    {
+      const int t = around[k];
+      if (emitted[t])
+        continue;
+
+      emitted[t] = 1;
+      order.push_back(t);
+      for (int j = 0; j < 3; j++)
+      {
+        const int v = varray[t * 3 + j];
+        dead.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (s - time[v] > cache)
+        {
+          time[v] = s++;
+        }
+      }
+    }
+
+    // Next fanning vertex: the oldest one in the cache that remains in the cache after its fan
+    f = -1;
+    int best = -1;
+    for (int v : candidates)
+    {
+      if (live[v] <= 0)
+        continue;
+      int p = 0;
+      if (s - time[v] + 2 * live[v] <= cache)
+      {
+        p = s - time[v];
+      }
+      if (p > best)
+      {
+        best = p;
+        f = v;
+      }
+    }
+
+    // Dead end: recently used vertex with live triangles, or else the next one in order
+    if (f < 0)
+    {
+      while (!dead.empty() && f < 0)
+      {
+        const int d = dead.back();
+        dead.pop_back();
+        if (live[d] > 0)
+        {
+          f = d;
+        }
+      }
+      while (f < 0 && cursor < nv)
+      {
+        if (live[cursor] > 0)
+        {
+          f = cursor;
+        }
+        cursor++;
+      }
+      if (f >= 0)
+      {
+        cluster.push_back(int(order.size()));
+      }
+    }
+  }
+  cluster.push_back(nt);
+
+  if (overdraw)
+  {
+    // Soft boundaries, where the cache miss ratio of the current cluster is below the average one
+    const double ratio = double(s - cache - 1) / double(nt);
+    std::vector<int> clusters;
+    std::fill(time.begin(), time.end(), -cache - 1);
+    s = 0;
+    for (int c = 0; c + 1 < int(cluster.size()); c++)
+    {
+      int first = cluster[c];
+      int misses = 0;
+      clusters.push_back(first);
+      for (int i = cluster[c]; i < cluster[c + 1]; i++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          const int v = varray[order[i] * 3 + j];
+          if (s - time[v] > cache)
+          {
+            time[v] = s++;
+            misses++;
+          }
+        }
+        if (i + 1 < cluster[c + 1] && i + 1 - first >= 8 * cache && misses < ratio * (i + 1 - first))
+        {
+          first = i + 1;
+          misses = 0;
+          clusters.push_back(first);
+        }
+      }
+    }
+    clusters.push_back(nt);
+
+    // Area weighted center and normals
+    const int nc = int(clusters.size()) - 1;
+    std::vector<Vector> centers(nc);
+    std::vector<Vector> normal(nc);
+    std::vector<double> area(nc);
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int c = 0; c < nc; c++)
+    {
+      Vector center(0.0);
+      Vector n(0.0);
+      double a = 0.0;
+      for (int i = clusters[c]; i < clusters[c + 1]; i++)
+      {
+        const Triangle triangle = GetTriangle(order[i]);
+        const Vector an = triangle.AreaNormal();
+        const double l = Norm(an);
+        center += l * triangle.Center();
+        n += an;
+        a += l;
+      }
+      centers[c] = a > 0.0 ? center / a : center;
+      normal[c] = n;
+      area[c] = a;
+    }
+
+    Vector center(0.0);
+    double a = 0.0;
+    for (int c = 0; c < nc; c++)
+    {
+      center += area[c] * centers[c];
+      a += area[c];
+    }
+    if (a > 0.0)
+    {
+      center = center / a;
+    }
+
+    std::vector<double> key(nc);
+    std::vector<int> sorted(nc);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < nc; c++)
+    {
+      const double l = Norm(normal[c]);
+      key[c] = l > 0.0 ? (centers[c] - center) * normal[c] / l : 0.0;
+      sorted[c] = c;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [&key](int x, int y) { return key[x] > key[y]; });
+
+    std::vector<int> reordered;
+    reordered.reserve(nt);
+    for (int c : sorted)
+    {
+      reordered.insert(reordered.end(), order.begin() + clusters[c], order.begin() + clusters[c + 1]);
+    }
+    order.swap(reordered);
+  }
+
+  // Vertices in the order of first use
+  std::vector<int> vertexes(nv, -1);
+  std::vector<int> source;
+  source.reserve(nv);
+  for (int t : order)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      const int v = varray[t * 3 + j];
+      if (vertexes[v] < 0)
+      {
+        vertexes[v] = int(source.size());
+        source.push_back(v);
+      }
+    }
+  }
+  for (int i = 0; i < nv; i++)
+  {
+    if (vertexes[i] < 0)
+    {
+      vertexes[i] = int(source.size());
+      source.push_back(i);
+    }
+  }
+
+  Remap(order, source, vertexes);
+}
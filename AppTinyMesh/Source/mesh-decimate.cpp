@@ -0,0 +1,982 @@
+// Decimation
+
+#include "mesh.h"
+#include "parallel.h"
+#include "topology.h"
+
+#include <algorithm>
+
+/*!
+\class QuadricDecimation
+\brief Edge collapse decimation driven by quadric error metrics, on points extended with attributes.
+
+Every vertex is a point of dimension n, its position followed by its attributes scaled to
+geometric units, and carries the sum of the quadrics of its triangles in that space, so that
+collapses trade geometric error against attribute error [Garland and Heckbert 1998]. Quadrics
+are packed: the upper triangle of the symmetric matrix A row by row, then the vector b and the
+constant c, the error of point x being x<sup>T</sup>Ax+2b<sup>T</sup>x+c.
+
+Candidate collapses are kept in a binary heap of compact entries that store the cost, the two
+vertices and the sum of their versions when the entry was pushed. Every collapse increments the
+versions of its two vertices, so that stale entries are detected and skipped when they are popped
+rather than updated in the heap.
+*/
+class QuadricDecimation
+{
+public:
+  //! Candidate collapse of vertex b into vertex a.
+  class Collapse
+  {
+  public:
+    float cost;         //!< Quadric error.
+    int a, b;           //!< Vertices, b is removed.
+    unsigned int stamp; //!< Sum of the versions of the vertices.
+
+    //! Reverse order, so that the standard heap functions build a min-heap.
+    bool operator<(const Collapse& c) const { return cost > c.cost; }
+  };
+public:
+  int n;                        //!< Dimension of the points.
+  int nq;                       //!< Size of a packed quadric.
+  std::vector<double> points;   //!< Points, n per vertex.
+  std::vector<double> quadrics; //!< Packed quadrics, nq per vertex.
+  std::vector<int> triangles;   //!< Vertex indexes, the first one is negative for removed triangles.
+  std::vector<int> parent;      //!< Vertex into which a vertex was collapsed, itself while it remains.
+  std::vector<char> locked;     //!< Vertices that can be neither moved nor removed.
+  std::vector<char> boundary;   //!< Boundary vertices.
+protected:
+  std::vector<unsigned int> version; //!< Versions of the vertices.
+  std::vector<int> start;            //!< First triangle of every vertex in the triangle references.
+  std::vector<int> count;            //!< Number of triangles of every vertex.
+  std::vector<int> refs;             //!< Triangle references, appended to by the collapses.
+  std::vector<Collapse> heap;        //!< Candidate collapses.
+  std::vector<int> ring[2];          //!< Scratch neighbor arrays.
+  int live = 0;                      //!< Number of remaining triangles.
+public:
+  explicit QuadricDecimation(int, int, int);
+
+  void AddTriangle(double*, int, int, int) const;
+  void AddPlane(double*, const Vector&, double, double) const;
+
+  void Run(int, double);
+protected:
+  double Error(const double*, const double*) const;
+  bool Minimize(const double*, double*) const;
+  double Target(int, int, double*) const;
+
+  void Build();
+  bool Contains(int, int) const;
+  void Push(int, int);
+  bool Valid(int, int, const double*);
+  void Apply(int, int, const double*);
+public:
+  static const int MaxDimension = 16; //!< Maximum dimension of the points.
+protected:
+  static const double Flip;           //!< Minimum cosine between the normals of a triangle before and after a collapse.
+};
+
+const double QuadricDecimation::Flip = 0.2;
+
+/*!
+\brief Create the decimation of a mesh, with null quadrics and no locked vertices.
+\param n Dimension of the points, at least three.
+\param nv, nt Number of vertices and triangles.
+*/
+QuadricDecimation::QuadricDecimation(int n, int nv, int nt) :n(n), nq(n* (n + 1) / 2 + n + 1)
+{
+  points.resize(nv * n);
+  quadrics.resize(nv * nq, 0.0);
+  triangles.resize(nt * 3);
+  parent.resize(nv);
+  locked.resize(nv, 0);
+  boundary.resize(nv, 0);
+  for (int i = 0; i < nv; i++)
+  {
+    parent[i] = i;
+  }
+}
+
+/*!
+\brief Add the quadric of a triangle, i.e. the squared distance to its plane in the space of the points.
+\param q Quadric.
+\param a, b, c Vertices.
+*/
+void QuadricDecimation::AddTriangle(double* q, int a, int b, int c) const
+{
+  const double* p = &points[a * n];
+  const double* r = &points[b * n];
+  const double* s = &points[c * n];
+
+  // Orthonormal frame of the plane
+  double e1[MaxDimension], e2[MaxDimension];
+  double l1 = 0.0, l2 = 0.0, d = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    e1[i] = r[i] - p[i];
+    e2[i] = s[i] - p[i];
+    l1 += e1[i] * e1[i];
+    l2 += e2[i] * e2[i];
+  }
+  if (l1 == 0.0 || l2 == 0.0)
+    return;
+
+  l1 = sqrt(l1);
+  for (int i = 0; i < n; i++)
+  {
+    e1[i] /= l1;
+    d += e1[i] * e2[i];
+  }
+  double l = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    e2[i] -= d * e1[i];
+    l += e2[i] * e2[i];
+  }
+  // Degenerate triangle
+  if (l <= 1e-12 * l2)
+    return;
+
+  l = sqrt(l);
+  double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    e2[i] /= l;
+    pe1 += p[i] * e1[i];
+    pe2 += p[i] * e2[i];
+    pp += p[i] * p[i];
+  }
+
+  // A = I - e1 e1^T - e2 e2^T, b = (p.e1) e1 + (p.e2) e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+  int k = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = i; j < n; j++)
+    {
+      q[k++] += (i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j];
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    q[k++] += pe1 * e1[i] + pe2 * e2[i] - p[i];
+  }
+  q[k] += pp - pe1 * pe1 - pe2 * pe2;
+}
+
+/*!
+\brief Add the weighted quadric of a plane that only constrains the positions.
+\param q Quadric.
+\param normal Unit normal of the plane.
+\param d Offset, the plane is defined as normal.x+d=0.
+\param w Weight.
+*/
+void QuadricDecimation::AddPlane(double* q, const Vector& normal, double d, double w) const
+{
+  int k = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = i; j < n; j++)
+    {
+      if (j < 3)
+      {
+        q[k] += w * normal[i] * normal[j];
+      }
+      k++;
+    }
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    q[k + i] += w * d * normal[i];
+  }
+  q[k + n] += w * d * d;
+}
+
+/*!
+\brief Evaluate a quadric.
+\param q Quadric.
+\param x Point.
+*/
+double QuadricDecimation::Error(const double* q, const double* x) const
+{
+  double e = 0.0;
+  int k = 0;
+  for (int i = 0; i < n; i++)
+  {
+    e += q[k++] * x[i] * x[i];
+    for (int j = i + 1; j < n; j++)
+    {
+      e += 2.0 * q[k++] * x[i] * x[j];
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    e += 2.0 * q[k++] * x[i];
+  }
+  return Math::Max(e + q[k], 0.0);
+}
+
+/*!
+\brief Compute the point that minimizes a quadric by solving Ax=-b with Gaussian elimination.
+\param q Quadric.
+\param x Returned point.
+\return False if the matrix is singular.
+*/
+bool QuadricDecimation::Minimize(const double* q, double* x) const
+{
+  double m[MaxDimension][MaxDimension + 1];
+  double scale = 0.0;
+  int k = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = i; j < n; j++)
+    {
+      m[i][j] = m[j][i] = q[k++];
+    }
+    scale = Math::Max(scale, fabs(m[i][i]));
+  }
+  for (int i = 0; i < n; i++)
+  {
+    m[i][n] = -q[k++];
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    // Partial pivoting
+    int p = i;
+    for (int j = i + 1; j < n; j++)
+    {
+      if (fabs(m[j][i]) > fabs(m[p][i]))
+      {
+        p = j;
+      }
+    }
+    if (fabs(m[p][i]) <= 1e-10 * scale)
+      return false;
+
+    if (p != i)
+    {
+      for (int j = i; j <= n; j++)
+      {
+        std::swap(m[i][j], m[p][j]);
+      }
+    }
+    for (int j = i + 1; j < n; j++)
+    {
+      const double f = m[j][i] / m[i][i];
+      for (int l = i; l <= n; l++)
+      {
+        m[j][l] -= f * m[i][l];
+      }
+    }
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    double s = m[i][n];
+    for (int j = i + 1; j < n; j++)
+    {
+      s -= m[i][j] * x[j];
+    }
+    x[i] = s / m[i][i];
+  }
+  return true;
+}
+
+/*!
+\brief Compute the point that replaces vertices a and b and its error.
+
+A locked vertex a keeps its point. Otherwise the minimizer of the quadric is used if it exists and
+lies close to the edge, or else the best of the two end points and the midpoint.
+\param a, b Vertices, b is removed.
+\param x Returned point.
+*/
+double QuadricDecimation::Target(int a, int b, double* x) const
+{
+  double q[MaxDimension * (MaxDimension + 3) / 2 + 1];
+  for (int k = 0; k < nq; k++)
+  {
+    q[k] = quadrics[a * nq + k] + quadrics[b * nq + k];
+  }
+
+  const double* pa = &points[a * n];
+  const double* pb = &points[b * n];
+
+  if (locked[a])
+  {
+    std::copy(pa, pa + n, x);
+    return Error(q, x);
+  }
+
+  if (Minimize(q, x))
+  {
+    // Reject far away minimizers of nearly singular quadrics
+    double d = 0.0, l = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+      const double c = x[i] - 0.5 * (pa[i] + pb[i]);
+      d += c * c;
+      l += (pb[i] - pa[i]) * (pb[i] - pa[i]);
+    }
+    if (d <= l)
+      return Error(q, x);
+  }
+
+  double y[MaxDimension] = {};
+  double e = Error(q, pa);
+  std::copy(pa, pa + n, x);
+
+  double f = Error(q, pb);
+  if (f < e)
+  {
+    e = f;
+    std::copy(pb, pb + n, x);
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    y[i] = 0.5 * (pa[i] + pb[i]);
+  }
+  f = Error(q, y);
+  if (f < e)
+  {
+    e = f;
+    std::copy(y, y + n, x);
+  }
+  return e;
+}
+
+/*!
+\brief Build the references from the vertices to their remaining triangles.
+*/
+void QuadricDecimation::Build()
+{
+  const int nv = int(parent.size());
+  const int nt = int(triangles.size()) / 3;
+
+  start.assign(nv + 1, 0);
+  count.assign(nv, 0);
+  live = 0;
+  for (int t = 0; t < nt; t++)
+  {
+    if (triangles[t * 3] < 0)
+      continue;
+    live++;
+    for (int j = 0; j < 3; j++)
+    {
+      start[triangles[t * 3 + j]]++;
+    }
+  }
+  for (int i = 0; i < nv; i++)
+  {
+    count[i] = start[i];
+  }
+  Parallel::ExclusiveScan(start);
+
+  refs.resize(start[nv]);
+  std::vector<int> cursor(start.begin(), start.end() - 1);
+  for (int t = 0; t < nt; t++)
+  {
+    if (triangles[t * 3] < 0)
+      continue;
+    for (int j = 0; j < 3; j++)
+    {
+      refs[cursor[triangles[t * 3 + j]]++] = t;
+    }
+  }
+  start.pop_back();
+}
+
+/*!
+\brief Check if a remaining triangle contains a vertex.
+\param t Triangle.
+\param v Vertex.
+*/
+inline bool QuadricDecimation::Contains(int t, int v) const
+{
+  return triangles[t * 3] == v || triangles[t * 3 + 1] == v || triangles[t * 3 + 2] == v;
+}
+
+/*!
+\brief Push the collapse of an edge, in the direction that keeps a locked vertex.
+\param a, b End vertices.
+*/
+void QuadricDecimation::Push(int a, int b)
+{
+  if (locked[b])
+  {
+    if (locked[a])
+      return;
+    std::swap(a, b);
+  }
+
+  double x[MaxDimension];
+  const double e = Target(a, b, x);
+  heap.push_back({ float(e), a, b, version[a] + version[b] });
+  std::push_heap(heap.begin(), heap.end());
+}
+
+/*!
+\brief Check that collapsing b into a preserves the topology and does not fold triangles.
+
+The link condition requires the common neighbors of a and b to be the opposite vertices of the
+triangles that share the edge. Interior edges between two boundary vertices are rejected, as well
+as collapses that turn a triangle by more than the flip threshold.
+\param a, b Vertices, b is removed.
+\param x New point.
+*/
+bool QuadricDecimation::Valid(int a, int b, const double* x)
+{
+  // Neighbors and triangles shared by the edge
+  int shared = 0;
+  for (int k = 0; k < 2; k++)
+  {
+    const int v = k == 0 ? a : b;
+    const int w = k == 0 ? b : a;
+    ring[k].clear();
+    for (int i = start[v]; i < start[v] + count[v]; i++)
+    {
+      const int t = refs[i];
+      if (triangles[t * 3] < 0)
+        continue;
+      if (k == 0 && Contains(t, b))
+      {
+        shared++;
+      }
+      for (int j = 0; j < 3; j++)
+      {
+        const int u = triangles[t * 3 + j];
+        if (u != v && u != w)
+        {
+          ring[k].push_back(u);
+        }
+      }
+    }
+    std::sort(ring[k].begin(), ring[k].end());
+    ring[k].erase(std::unique(ring[k].begin(), ring[k].end()), ring[k].end());
+  }
+
+  if (shared == 0 || shared > 2)
+    return false;
+  if (shared == 2 && boundary[a] && boundary[b])
+    return false;
+
+  int common = 0;
+  for (int i = 0, j = 0; i < int(ring[0].size()) && j < int(ring[1].size());)
+  {
+    if (ring[0][i] < ring[1][j])
+      i++;
+    else if (ring[0][i] > ring[1][j])
+      j++;
+    else
+    {
+      common++;
+      i++;
+      j++;
+    }
+  }
+  if (common != shared)
+    return false;
+  // Closed meshes must keep at least a tetrahedron around the new vertex
+  if (shared == 2 && int(ring[0].size() + ring[1].size()) - common < 3)
+    return false;
+
+  // Flipped triangles
+  const Vector p(x[0], x[1], x[2]);
+  for (int k = 0; k < 2; k++)
+  {
+    const int v = k == 0 ? a : b;
+    const int w = k == 0 ? b : a;
+    for (int i = start[v]; i < start[v] + count[v]; i++)
+    {
+      const int t = refs[i];
+      if (triangles[t * 3] < 0 || Contains(t, w))
+        continue;
+
+      Vector q[3], r[3];
+      for (int j = 0; j < 3; j++)
+      {
+        const int u = triangles[t * 3 + j];
+        q[j] = Vector(points[u * n], points[u * n + 1], points[u * n + 2]);
+        r[j] = u == v ? p : q[j];
+      }
+      const Vector before = (q[1] - q[0]) / (q[2] - q[0]);
+      const Vector after = (r[1] - r[0]) / (r[2] - r[0]);
+      const double l = Norm(before);
+      if (l > 0.0 && before * after <= Flip * l * Norm(after))
+        return false;
+    }
+  }
+  return true;
+}
+
+/*!
+\brief Collapse vertex b into vertex a.
+\param a, b Vertices, b is removed.
+\param x New point.
+*/
+void QuadricDecimation::Apply(int a, int b, const double* x)
+{
+  // Remove the triangles of the edge, and connect the other ones to a
+  for (int i = start[b]; i < start[b] + count[b]; i++)
+  {
+    const int t = refs[i];
+    if (triangles[t * 3] < 0)
+      continue;
+    if (Contains(t, a))
+    {
+      triangles[t * 3] = -1;
+      live--;
+    }
+    else
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        if (triangles[t * 3 + j] == b)
+        {
+          triangles[t * 3 + j] = a;
+        }
+      }
+    }
+  }
+
+  // Append the remaining triangles of both vertices as the triangles of a
+  const int s = int(refs.size());
+  for (int k = 0; k < 2; k++)
+  {
+    const int v = k == 0 ? a : b;
+    const int e = start[v] + count[v];
+    for (int i = start[v]; i < e; i++)
+    {
+      if (triangles[refs[i] * 3] >= 0)
+      {
+        refs.push_back(refs[i]);
+      }
+    }
+  }
+  start[a] = s;
+  count[a] = int(refs.size()) - s;
+
+  std::copy(x, x + n, &points[a * n]);
+  for (int k = 0; k < nq; k++)
+  {
+    quadrics[a * nq + k] += quadrics[b * nq + k];
+  }
+  boundary[a] |= boundary[b];
+  parent[b] = a;
+  version[a]++;
+  version[b]++;
+
+  // New candidates around a
+  ring[0].clear();
+  for (int i = start[a]; i < start[a] + count[a]; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      const int u = triangles[refs[i] * 3 + j];
+      if (u != a)
+      {
+        ring[0].push_back(u);
+      }
+    }
+  }
+  std::sort(ring[0].begin(), ring[0].end());
+  ring[0].erase(std::unique(ring[0].begin(), ring[0].end()), ring[0].end());
+  for (int u : ring[0])
+  {
+    Push(a, u);
+  }
+}
+
+/*!
+\brief Collapse edges in order of increasing error.
+\param target Number of triangles at which the decimation stops.
+\param error Maximum error, as a distance, negative for no bound.
+*/
+void QuadricDecimation::Run(int target, double error)
+{
+  const int nv = int(parent.size());
+  const int nt = int(triangles.size()) / 3;
+  const double bound = error * error;
+
+  Build();
+  version.assign(nv, 0);
+
+  // Every edge once: from its lower vertex, or along its single half-edge on the boundary
+  heap.clear();
+  for (int t = 0; t < nt; t++)
+  {
+    if (triangles[t * 3] < 0)
+      continue;
+    for (int j = 0; j < 3; j++)
+    {
+      const int a = triangles[t * 3 + j];
+      const int b = triangles[t * 3 + (j + 1) % 3];
+      bool push = a < b;
+      if (!push)
+      {
+        push = true;
+        for (int i = start[a]; i < start[a] + count[a]; i++)
+        {
+          if (refs[i] != t && Contains(refs[i], b))
+          {
+            push = false;
+            break;
+          }
+        }
+      }
+      if (push)
+      {
+        Push(a, b);
+      }
+    }
+  }
+
+  const size_t compact = 2 * refs.size() + 1024;
+  double x[MaxDimension];
+  while (live > target && !heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end());
+    const Collapse c = heap.back();
+    heap.pop_back();
+
+    if (error >= 0.0 && c.cost > bound)
+      break;
+    if (parent[c.a] != c.a || parent[c.b] != c.b || version[c.a] + version[c.b] != c.stamp)
+      continue;
+
+    Target(c.a, c.b, x);
+    if (!Valid(c.a, c.b, x))
+      continue;
+
+    Apply(c.a, c.b, x);
+
+    if (refs.size() > compact)
+    {
+      Build();
+    }
+  }
+}
+
+/*!
+\brief Simplify the mesh by collapsing edges in order of increasing quadric error.
+
+Vertices are points of dimension three extended with their attributes, i.e. normals when indexed
+like the vertices and the colors of a MeshColor, weighted against the size of the mesh, so that
+the error accounts for both the geometry and the attributes. Boundary edges are preserved by
+quadrics of planes orthogonal to their triangles, and non-manifold vertices are locked.
+Collapses are taken from a priority queue with lazy invalidation, and rejected if they break
+the topology or fold triangles.
+
+In parallel, vertices are first split into slabs of equal sizes along the largest axis of the
+box, which are decimated independently while their shared vertices are locked, before a final
+pass over the whole mesh.
+
+Normals that are not indexed like the vertices keep their indexes.
+\param target Number of triangles, 0 to stop only on the error.
+\param error Maximum quadric error, as a distance, negative for no bound.
+\param parallel Decimate independent spatial partitions in parallel first.
+*/
+void Mesh::Decimate(int target, double error, bool parallel)
+{
+  const int nv = Vertexes();
+  const int nt = Triangles();
+  if (nt == 0 || target >= nt)
+    return;
+
+  // Points of dimension three extended with the attributes
+  const Box box = GetBox();
+  const double scale = 0.02 * Norm(box.Diagonal());
+  const double weight = 10.0;
+
+  std::vector<double> attributes;
+  int m = VertexAttributes(attributes);
+  if (3 + m > QuadricDecimation::MaxDimension || scale == 0.0)
+  {
+    m = 0;
+  }
+  const int n = 3 + m;
+
+  QuadricDecimation decimation(n, nv, nt);
+  decimation.triangles = varray;
+
+  const MeshTopology& topology = Topology();
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      decimation.points[i * n + j] = vertices[i][j];
+    }
+    for (int j = 0; j < m; j++)
+    {
+      decimation.points[i * n + 3 + j] = scale * attributes[i * m + j];
+    }
+    decimation.locked[i] = topology.IsNonManifoldVertex(i);
+    decimation.boundary[i] = topology.IsBoundaryVertex(i);
+  }
+
+  // Quadrics gathered per vertex
+  std::vector<int> offset;
+  std::vector<int> around;
+  VertexTriangles(offset, around);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    double* q = &decimation.quadrics[i * decimation.nq];
+    for (int k = offset[i]; k < offset[i + 1]; k++)
+    {
+      const int t = around[k];
+      if (k != offset[i] && around[k - 1] == t)
+        continue;
+
+      decimation.AddTriangle(q, varray[t * 3], varray[t * 3 + 1], varray[t * 3 + 2]);
+
+      // Planes of the boundary edges of the vertex
+      for (int j = 0; j < 3; j++)
+      {
+        const int h = t * 3 + j;
+        const int a = varray[h];
+        const int b = varray[MeshTopology::Next(h)];
+        if (!topology.IsBoundary(h) || (a != i && b != i))
+          continue;
+
+        const Vector normal = Triangle(vertices[varray[t * 3]], vertices[varray[t * 3 + 1]], vertices[varray[t * 3 + 2]]).AreaNormal();
+        Vector side = (vertices[b] - vertices[a]) / normal;
+        const double l = Norm(side);
+        if (l == 0.0)
+          continue;
+        side = side / l;
+        decimation.AddPlane(q, side, -(side * vertices[a]), weight);
+      }
+    }
+  }
+
+  offset = std::vector<int>();
+  around = std::vector<int>();
+
+  const int parts = 2 * Parallel::Threads();
+  if (parallel && parts > 2 && nt >= Parallel::Grain)
+  {
+    // Slabs with equal numbers of vertices along the largest axis
+    const Vector diagonal = box.Diagonal();
+    const int axis = diagonal[0] >= diagonal[1] ? (diagonal[0] >= diagonal[2] ? 0 : 2) : (diagonal[1] >= diagonal[2] ? 1 : 2);
+    const double extent = Math::Max(diagonal[axis], 1e-300);
+
+    std::vector<unsigned long long> keys(nv);
+    std::vector<int> order(nv);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      keys[i] = (unsigned long long)(Math::Clamp((vertices[i][axis] - box[0][axis]) / extent) * 4294967295.0);
+      order[i] = i;
+    }
+    Parallel::RadixSort(keys, order);
+    keys = std::vector<unsigned long long>();
+
+    std::vector<int> part(nv);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      part[order[i]] = int((long long)(i) * parts / nv);
+    }
+
+    // Triangles inside a slab, grouped by slab, the other ones are left for the final pass
+    std::vector<int> first(parts + 1, 0);
+    std::vector<int> inside(nt);
+#pragma omp parallel for schedule(static)
+    for (int t = 0; t < nt; t++)
+    {
+      const int k = part[varray[t * 3]];
+      inside[t] = (part[varray[t * 3 + 1]] == k && part[varray[t * 3 + 2]] == k) ? k : -1;
+    }
+    for (int t = 0; t < nt; t++)
+    {
+      if (inside[t] >= 0)
+      {
+        first[inside[t]]++;
+      }
+    }
+    Parallel::ExclusiveScan(first);
+    std::vector<int> slab(first[parts]);
+    std::vector<int> cursor(first.begin(), first.end() - 1);
+    for (int t = 0; t < nt; t++)
+    {
+      if (inside[t] >= 0)
+      {
+        slab[cursor[inside[t]]++] = t;
+      }
+    }
+
+    // Vertices of triangles across slabs and their neighbors are locked,
+    // so that the collapses only involve vertices whose triangles all lie in the slab
+    std::vector<char> shared(nv, 0);
+    for (int t = 0; t < nt; t++)
+    {
+      if (inside[t] < 0)
+      {
+        shared[varray[t * 3]] = shared[varray[t * 3 + 1]] = shared[varray[t * 3 + 2]] = 1;
+      }
+    }
+    std::vector<char> near = shared;
+    for (int t = 0; t < nt; t++)
+    {
+      if (shared[varray[t * 3]] || shared[varray[t * 3 + 1]] || shared[varray[t * 3 + 2]])
+      {
+        near[varray[t * 3]] = near[varray[t * 3 + 1]] = near[varray[t * 3 + 2]] = 1;
+      }
+    }
+
+    // Local indexes, a vertex only belongs to the triangles of its own slab
+    std::vector<int> local(nv, -1);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < parts; k++)
+    {
+      const int lt = first[k + 1] - first[k];
+      if (lt == 0)
+        continue;
+
+      std::vector<int> global;
+      for (int i = first[k]; i < first[k + 1]; i++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          const int v = varray[slab[i] * 3 + j];
+          if (local[v] < 0)
+          {
+            local[v] = int(global.size());
+            global.push_back(v);
+          }
+        }
+      }
+
+      const int lv = int(global.size());
+      QuadricDecimation d(n, lv, lt);
+      for (int i = 0; i < lv; i++)
+      {
+        const int v = global[i];
+        std::copy(&decimation.points[v * n], &decimation.points[v * n] + n, &d.points[i * n]);
+        std::copy(&decimation.quadrics[v * d.nq], &decimation.quadrics[v * d.nq] + d.nq, &d.quadrics[i * d.nq]);
+        d.locked[i] = decimation.locked[v] || near[v];
+        d.boundary[i] = decimation.boundary[v];
+      }
+      for (int i = 0; i < lt; i++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          d.triangles[i * 3 + j] = local[varray[slab[first[k] + i] * 3 + j]];
+        }
+      }
+
+      // Triangles of locked vertices are left to the final pass, the other ones are decimated to the same ratio
+      int fixed = 0;
+      for (int i = 0; i < lt; i++)
+      {
+        if (d.locked[d.triangles[i * 3]] && d.locked[d.triangles[i * 3 + 1]] && d.locked[d.triangles[i * 3 + 2]])
+        {
+          fixed++;
+        }
+      }
+      d.Run(target > 0 ? fixed + int((long long)(lt - fixed) * target / nt) : 0, error);
+
+      // Copy back
+      for (int i = 0; i < lv; i++)
+      {
+        const int v = global[i];
+        std::copy(&d.points[i * n], &d.points[i * n] + n, &decimation.points[v * n]);
+        std::copy(&d.quadrics[i * d.nq], &d.quadrics[i * d.nq] + d.nq, &decimation.quadrics[v * d.nq]);
+        decimation.boundary[v] = d.boundary[i];
+        decimation.parent[v] = global[d.parent[i]];
+      }
+      for (int i = 0; i < lt; i++)
+      {
+        const int t = slab[first[k] + i];
+        for (int j = 0; j < 3; j++)
+        {
+          decimation.triangles[t * 3 + j] = d.triangles[i * 3] < 0 ? -1 : global[d.triangles[i * 3 + j]];
+        }
+      }
+    }
+  }
+
+  decimation.Run(target, error);
+
+  // Remaining vertices, by pointer jumping along the collapses
+  std::vector<int>& rep = decimation.parent;
+  std::vector<int> next(nv);
+  int changed = 1;
+  while (changed != 0)
+  {
+    changed = 0;
+#pragma omp parallel for schedule(static) reduction(+:changed)
+    for (int i = 0; i < nv; i++)
+    {
+      next[i] = rep[rep[i]];
+      if (next[i] != rep[i])
+      {
+        changed++;
+      }
+    }
+    rep.swap(next);
+  }
+  next = std::vector<int>();
+
+  std::vector<int> vertexes(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    vertexes[i] = (rep[i] == i) ? 1 : 0;
+  }
+  const int nr = Parallel::ExclusiveScan(vertexes);
+
+  std::vector<int> source(nr);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    if (rep[i] == i)
+    {
+      source[vertexes[i]] = i;
+
+      const double* p = &decimation.points[i * n];
+      vertices[i] = Vector(p[0], p[1], p[2]);
+      for (int j = 0; j < m; j++)
+      {
+        attributes[i * m + j] = p[3 + j] / scale;
+      }
+    }
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    if (rep[i] != i)
+    {
+      vertexes[i] = vertexes[rep[i]];
+    }
+  }
+  if (m > 0)
+  {
+    SetVertexAttributes(attributes, m);
+  }
+
+  // Remaining triangles
+  std::vector<int> keep(nt);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    keep[i] = decimation.triangles[i * 3] >= 0 ? 1 : 0;
+  }
+  std::vector<int> index = keep;
+  const int nk = Parallel::ExclusiveScan(index);
+
+  std::vector<int> triangles(nk);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    if (keep[i])
+    {
+      triangles[index[i]] = i;
+    }
+  }
+
+  Remap(triangles, source, vertexes);
+}
@@ -0,0 +1,179 @@
+// Smoothing
+
+#include "mesh.h"
+#include "topology.h"
+#include "parallel.h"
+
+/*!
+\brief Smooth the mesh by moving every vertex toward the weighted average of its neighbors.
+
+The one-ring of every vertex is stored in compressed sparse row form with normalized weights,
+built once by sorting the directed edges of the triangles with a parallel radix sort. Cotangent
+weights are computed on the input mesh, and negative weights of obtuse triangles are clamped.
+Positions are double buffered, so that every step is a parallel loop over the vertices.
+
+Boundary and non-manifold vertices, as well as the end points of the edges whose dihedral
+angle exceeds a threshold, may be locked. Normals are recomputed with SmoothNormals().
+\param iterations Number of iterations.
+\param lambda, mu Scale factors of the two steps of every iteration, the second one is skipped if mu is null.
+\param cotangent Use cotangent weights instead of uniform weights.
+\param feature Dihedral angle in degrees above which edges are locked, negative to disable.
+\param boundary Lock boundary and non-manifold vertices.
+*/
+void Mesh::Smooth(int iterations, double lambda, double mu, bool cotangent, double feature, bool boundary)
+{
+  const int nv = Vertexes();
+  const int nh = int(varray.size());
+  if (iterations <= 0 || nh == 0)
+    return;
+
+  // Directed edges in both directions, weighted by half the cotangent of the opposite angle
+  std::vector<unsigned long long> keys(2 * nh);
+  std::vector<int> values(2 * nh);
+  std::vector<double> weight(2 * nh);
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < nh; h++)
+  {
+    const int a = varray[h];
+    const int b = varray[MeshTopology::Next(h)];
+    double w = 1.0;
+    if (cotangent)
+    {
+      const Vector c = vertices[varray[MeshTopology::Prev(h)]];
+      const Vector u = vertices[a] - c;
+      const Vector v = vertices[b] - c;
+      const double s = Norm(u / v);
+      w = s > 0.0 ? Math::Max(0.5 * (u * v) / s, 0.0) : 0.0;
+    }
+    keys[2 * h] = (unsigned long long)(a) << 32 | (unsigned int)(b);
+    keys[2 * h + 1] = (unsigned long long)(b) << 32 | (unsigned int)(a);
+    values[2 * h] = 2 * h;
+    values[2 * h + 1] = 2 * h + 1;
+    weight[2 * h] = weight[2 * h + 1] = w;
+  }
+  Parallel::RadixSort(keys, values);
+
+  // Unique neighbors, the weights of the duplicates are summed for cotangent weights
+  const int n = 2 * nh;
+  std::vector<int> index(n);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++)
+  {
+    index[i] = (i == 0 || keys[i] != keys[i - 1]) ? 1 : 0;
+  }
+  const int nu = Parallel::ExclusiveScan(index);
+
+  std::vector<int> neighbor(nu);
+  std::vector<double> w(nu);
+  std::vector<int> offset(nv + 1, -1);
+  offset[nv] = nu;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++)
+  {
+    if (i == 0 || keys[i] != keys[i - 1])
+    {
+      const int a = int(keys[i] >> 32);
+      double s = 0.0;
+      for (int j = i; j < n && keys[j] == keys[i]; j++)
+      {
+        s += weight[values[j]];
+      }
+      neighbor[index[i]] = int(keys[i] & 0xffffffffull);
+      w[index[i]] = cotangent ? s : 1.0;
+      if (i == 0 || int(keys[i - 1] >> 32) != a)
+      {
+        offset[a] = index[i];
+      }
+    }
+  }
+  for (int i = nv - 1; i >= 0; i--)
+  {
+    if (offset[i] == -1)
+    {
+      offset[i] = offset[i + 1];
+    }
+  }
+
+  // Locked vertices, shared vertices are flagged by several half-edges hence the atomic writes
+  std::vector<char> locked(nv, 0);
+  if (boundary || feature >= 0.0)
+  {
+    const MeshTopology& topology = Topology();
+    const double c = cos(Math::DegreeToRadian(feature));
+#pragma omp parallel for schedule(static)
+    for (int h = 0; h < nh; h++)
+    {
+      const int a = varray[h];
+      if (boundary && (topology.IsBoundaryVertex(a) || topology.IsNonManifoldVertex(a)))
+      {
+#pragma omp atomic write
+        locked[a] = 1;
+      }
+      const int g = topology.Twin(h);
+      if (feature >= 0.0 && g > h)
+      {
+        const int t = MeshTopology::Face(h);
+        const int s = MeshTopology::Face(g);
+        const Vector p = (vertices[varray[3 * t + 1]] - vertices[varray[3 * t]]) / (vertices[varray[3 * t + 2]] - vertices[varray[3 * t]]);
+        const Vector q = (vertices[varray[3 * s + 1]] - vertices[varray[3 * s]]) / (vertices[varray[3 * s + 2]] - vertices[varray[3 * s]]);
+        const double l = Norm(p) * Norm(q);
+        if (l > 0.0 && (p * q) < c * l)
+        {
+          // Both end points, the twin half-edge has the same ones
+#pragma omp atomic write
+          locked[a] = 1;
+#pragma omp atomic write
+          locked[varray[MeshTopology::Next(h)]] = 1;
+        }
+      }
+    }
+  }
+
+  // Normalized weights
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    double s = 0.0;
+    for (int j = offset[i]; j < offset[i + 1]; j++)
+    {
+      s += w[j];
+    }
+    if (s <= 0.0)
+    {
+      locked[i] = 1;
+      continue;
+    }
+    for (int j = offset[i]; j < offset[i + 1]; j++)
+    {
+      w[j] /= s;
+    }
+  }
+
+  // Double buffered steps
+  std::vector<Vector> p = vertices;
+  std::vector<Vector> q(nv);
+  const int steps = mu != 0.0 ? 2 * iterations : iterations;
+  for (int k = 0; k < steps; k++)
+  {
+    const double f = (mu != 0.0 && k % 2 == 1) ? mu : lambda;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      if (locked[i])
+      {
+        q[i] = p[i];
+        continue;
+      }
+      Vector a = Vector::Null;
+      for (int j = offset[i]; j < offset[i + 1]; j++)
+      {
+        a += w[j] * p[neighbor[j]];
+      }
+      q[i] = p[i] + f * (a - p[i]);
+    }
+    p.swap(q);
+  }
+
+  vertices.swap(p);
+  SmoothNormals();
+}
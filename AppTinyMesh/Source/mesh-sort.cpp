@@ -0,0 +1,130 @@
+// Spatial sort
+
+#include "mesh.h"
+#include "parallel.h"
+
+/*!
+\brief Spread the 21 lower bits of an integer so that two null bits separate consecutive ones.
+\param x Integer.
+*/
+static unsigned long long Spread(unsigned int x)
+{
+  unsigned long long v = x & 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffull;
+  v = (v | v << 16) & 0x1f0000ff0000ffull;
+  v = (v | v << 8) & 0x100f00f00f00f00full;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+  v = (v | v << 2) & 0x1249249249249249ull;
+  return v;
+}
+
+/*!
+\brief Compute the Morton code of a point of the 21 bits integer grid.
+\param x, y, z Coordinates.
+*/
+static unsigned long long Morton(unsigned int x, unsigned int y, unsigned int z)
+{
+  return (Spread(x) << 2) | (Spread(y) << 1) | Spread(z);
+}
+
+/*!
+\brief Compute the index of a point of the 21 bits integer grid along the Hilbert curve.
+
+The coordinates are converted into the transposed index [Skilling 2004], whose bits are then interleaved.
+\param x, y, z Coordinates.
+*/
+static unsigned long long Hilbert(unsigned int x, unsigned int y, unsigned int z)
+{
+  unsigned int X[3] = { x, y, z };
+  const unsigned int m = 1u << 20;
+
+  // Inverse undo, without branches: invert the lower bits of X[0] if the bit of X[i] is set, or else exchange them
+  for (unsigned int q = m; q > 1; q >>= 1)
+  {
+    const unsigned int p = q - 1;
+    for (int i = 0; i < 3; i++)
+    {
+      const unsigned int s = 0u - ((X[i] & q) != 0 ? 1u : 0u);
+      const unsigned int t = (X[0] ^ X[i]) & p & ~s;
+      X[0] ^= (p & s) ^ t;
+      X[i] ^= t;
+    }
+  }
+
+  // Gray encode
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  unsigned int t = 0;
+  for (unsigned int q = m; q > 1; q >>= 1)
+  {
+    t ^= (q - 1) & (0u - ((X[2] & q) != 0 ? 1u : 0u));
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    X[i] ^= t;
+  }
+
+  return Morton(X[0], X[1], X[2]);
+}
+
+/*!
+\brief Sort the vertices and the triangles along a space-filling curve, so that elements close in
+space are close in memory.
+
+Vertices are sorted by the code of their position on a grid of 2<sup>21</sup> cells per axis
+over the box of the mesh, and triangles by the code of their center, with a parallel radix sort.
+Vertex and normal indexes are remapped accordingly.
+\param hilbert Use the Hilbert curve, whose consecutive cells are adjacent, instead of the Morton order.
+*/
+void Mesh::SpatialSort(bool hilbert)
+{
+  const int nv = Vertexes();
+  const int nt = Triangles();
+  if (nv == 0)
+    return;
+
+  const Box box = GetBox();
+  const Vector diagonal = box.Diagonal();
+  const double extent = Math::Max(diagonal[0], diagonal[1], diagonal[2]);
+  const double scale = extent > 0.0 ? double((1 << 21) - 1) / extent : 0.0;
+
+  auto code = [&](const Vector& p) -> unsigned long long
+  {
+    const Vector q = (p - box[0]) * scale;
+    const unsigned int x = (unsigned int)(Math::Clamp(q[0], 0.0, double((1 << 21) - 1)));
+    const unsigned int y = (unsigned int)(Math::Clamp(q[1], 0.0, double((1 << 21) - 1)));
+    const unsigned int z = (unsigned int)(Math::Clamp(q[2], 0.0, double((1 << 21) - 1)));
+    return hilbert ? Hilbert(x, y, z) : Morton(x, y, z);
+  };
+
+  // Vertices
+  std::vector<unsigned long long> keys(nv);
+  std::vector<int> source(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    keys[i] = code(vertices[i]);
+    source[i] = i;
+  }
+  Parallel::RadixSort(keys, source);
+
+  std::vector<int> vertexes(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    vertexes[source[i]] = i;
+  }
+
+  // Triangles
+  keys.resize(nt);
+  std::vector<int> triangles(nt);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    keys[i] = code((vertices[varray[i * 3]] + vertices[varray[i * 3 + 1]] + vertices[varray[i * 3 + 2]]) / 3.0);
+    triangles[i] = i;
+  }
+  Parallel::RadixSort(keys, triangles);
+
+  Remap(triangles, source, vertexes);
+}
@@ -0,0 +1,291 @@
+// Loop subdivision
+
+#include "mesh.h"
+#include "parallel.h"
+
+/*!
+\brief Subdivide the mesh with the Loop scheme [Loop 1987].
+
+Every triangle is split into four, and positions are smoothed by the Loop masks: edge points are
+weighted 3/8 by the end points of the edge and 1/8 by the two opposite vertices, and the vertices
+of valence n are weighted 1-n&beta; by themselves and &beta; by their neighbors. Boundary edges
+and vertices use the cubic B-spline masks of the boundary curve, and non-manifold vertices are
+kept fixed.
+
+Every level sorts the half-edges by their pair of vertices with a parallel radix sort, so that
+the half-edges of every edge are contiguous, and the neighbors of every vertex are gathered
+with a second sort. The number of vertices and triangles of every level follows from the number
+of edges of the input mesh, so that the output arrays of all levels are allocated once.
+
+Attributes indexed like the vertices, such as colors, are subdivided with the same masks.
+Normals are not subdivided, they are recomputed with SmoothNormals().
+\param levels Number of subdivision levels.
+*/
+void Mesh::Subdivide(int levels)
+{
+  if (levels <= 0 || Triangles() == 0)
+    return;
+
+  // Normals are recomputed, they are discarded so that the attributes only hold those of derived classes
+  normals.clear();
+  narray.clear();
+  std::vector<double> attributes;
+  const int m = VertexAttributes(attributes);
+  const int d = 3 + m;
+
+  int nv = Vertexes();
+  int nt = Triangles();
+
+  // Ping-pong buffers of points, positions followed by attributes
+  std::vector<double> p[2];
+  std::vector<int> t[2];
+  std::vector<unsigned long long> keys;
+  std::vector<int> values;
+
+  p[0].resize(size_t(nv) * d);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      p[0][size_t(i) * d + k] = vertices[i][k];
+    }
+    for (int k = 0; k < m; k++)
+    {
+      p[0][size_t(i) * d + 3 + k] = attributes[size_t(i) * m + k];
+    }
+  }
+  t[0] = varray;
+
+  for (int level = 0; level < levels; level++)
+  {
+    const std::vector<double>& src = p[level & 1];
+    std::vector<double>& dst = p[(level + 1) & 1];
+    const std::vector<int>& tri = t[level & 1];
+    std::vector<int>& out = t[(level + 1) & 1];
+    const int nh = 3 * nt;
+
+    // Half-edges sorted by their pair of vertices
+    keys.resize(nh);
+    values.resize(nh);
+#pragma omp parallel for schedule(static)
+    for (int h = 0; h < nh; h++)
+    {
+      const unsigned int a = tri[h];
+      const unsigned int b = tri[h % 3 == 2 ? h - 2 : h + 1];
+      keys[h] = a < b ? (unsigned long long)(a) << 32 | b : (unsigned long long)(b) << 32 | a;
+      values[h] = h;
+    }
+    Parallel::RadixSort(keys, values);
+
+    // Edges, as runs of half-edges with the same key
+    std::vector<int> edge(nh);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nh; i++)
+    {
+      edge[i] = (i == 0 || keys[i] != keys[i - 1]) ? 1 : 0;
+    }
+    const int ne = Parallel::ExclusiveScan(edge);
+
+    std::vector<int> start(ne + 1);
+    std::vector<int> half(nh);
+    start[ne] = nh;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nh; i++)
+    {
+      const bool first = (i == 0 || keys[i] != keys[i - 1]);
+      if (first)
+      {
+        start[edge[i]] = i;
+      }
+      half[values[i]] = edge[i] - (first ? 0 : 1);
+    }
+
+    // Allocation of the output arrays of all the levels, sized from the edges of the first level
+    if (level == 0)
+    {
+      size_t mv = nv, me = ne, mt = nt, mk = 0;
+      for (int l = 0; l < levels; l++)
+      {
+        mk = 3 * mt > 2 * me ? 3 * mt : 2 * me;
+        mv += me;
+        me = 2 * me + 3 * mt;
+        mt *= 4;
+      }
+      p[0].reserve(mv * d);
+      p[1].reserve(mv * d);
+      t[0].reserve(3 * mt);
+      t[1].reserve(3 * mt);
+      keys.reserve(mk);
+      values.reserve(mk);
+    }
+    dst.resize(size_t(nv + ne) * d);
+    out.resize(size_t(12) * nt);
+
+    // Edge points
+#pragma omp parallel for schedule(static)
+    for (int e = 0; e < ne; e++)
+    {
+      const int h = values[start[e]];
+      const int count = start[e + 1] - start[e];
+      const double* a = &src[size_t(tri[h]) * d];
+      const double* b = &src[size_t(tri[h % 3 == 2 ? h - 2 : h + 1]) * d];
+      double* q = &dst[size_t(nv + e) * d];
+      if (count == 2)
+      {
+        const int g = values[start[e] + 1];
+        const double* c = &src[size_t(tri[h % 3 == 0 ? h + 2 : h - 1]) * d];
+        const double* f = &src[size_t(tri[g % 3 == 0 ? g + 2 : g - 1]) * d];
+        for (int k = 0; k < d; k++)
+        {
+          q[k] = 0.375 * (a[k] + b[k]) + 0.125 * (c[k] + f[k]);
+        }
+      }
+      else
+      {
+        // Boundary and non-manifold edges
+        for (int k = 0; k < d; k++)
+        {
+          q[k] = 0.5 * (a[k] + b[k]);
+        }
+      }
+    }
+
+    // Neighbors of the vertices, every edge is listed from both of its end points
+    std::vector<unsigned long long> ends(2 * ne);
+    std::vector<int> count(ne);
+#pragma omp parallel for schedule(static)
+    for (int e = 0; e < ne; e++)
+    {
+      const unsigned long long key = keys[start[e]];
+      ends[2 * e] = key >> 32;
+      ends[2 * e + 1] = key & 0xffffffffull;
+      count[e] = start[e + 1] - start[e];
+    }
+    keys.resize(2 * ne);
+    values.resize(2 * ne);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < 2 * ne; i++)
+    {
+      keys[i] = ends[i];
+      values[i] = i ^ 1;
+    }
+    Parallel::RadixSort(keys, values);
+
+    // Vertex points, the neighbors of vertex i are the other ends of the entries first[i] to first[i+1]-1
+    std::vector<int> first(nv + 1, -1);
+    first[nv] = 2 * ne;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < 2 * ne; i++)
+    {
+      if (i == 0 || keys[i] != keys[i - 1])
+      {
+        first[int(keys[i])] = i;
+      }
+    }
+    for (int i = nv - 1; i >= 0; i--)
+    {
+      if (first[i] == -1)
+      {
+        first[i] = first[i + 1];
+      }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      const double* a = &src[size_t(i) * d];
+      double* q = &dst[size_t(i) * d];
+      const int n = first[i + 1] - first[i];
+
+      int boundary = 0;
+      bool manifold = true;
+      int b[2] = { -1, -1 };
+      for (int j = first[i]; j < first[i + 1]; j++)
+      {
+        const int c = count[values[j] / 2];
+        if (c == 1)
+        {
+          if (boundary < 2)
+          {
+            b[boundary] = int(ends[values[j]]);
+          }
+          boundary++;
+        }
+        manifold = manifold && c <= 2;
+      }
+
+      if (n == 0 || !manifold || (boundary != 0 && boundary != 2))
+      {
+        for (int k = 0; k < d; k++)
+        {
+          q[k] = a[k];
+        }
+      }
+      else if (boundary == 2)
+      {
+        const double* u = &src[size_t(b[0]) * d];
+        const double* v = &src[size_t(b[1]) * d];
+        for (int k = 0; k < d; k++)
+        {
+          q[k] = 0.75 * a[k] + 0.125 * (u[k] + v[k]);
+        }
+      }
+      else
+      {
+        const double w = 0.375 + 0.25 * cos(2.0 * 3.14159265358979323846 / n);
+        const double beta = (0.625 - w * w) / n;
+        for (int k = 0; k < d; k++)
+        {
+          q[k] = (1.0 - n * beta) * a[k];
+        }
+        for (int j = first[i]; j < first[i + 1]; j++)
+        {
+          const double* u = &src[size_t(ends[values[j]]) * d];
+          for (int k = 0; k < d; k++)
+          {
+            q[k] += beta * u[k];
+          }
+        }
+      }
+    }
+
+    // Four triangles per triangle, edge points are numbered after the vertices
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nt; i++)
+    {
+      const int a = tri[3 * i], b = tri[3 * i + 1], c = tri[3 * i + 2];
+      const int ab = nv + half[3 * i], bc = nv + half[3 * i + 1], ca = nv + half[3 * i + 2];
+      int* o = &out[size_t(12) * i];
+      o[0] = a; o[1] = ab; o[2] = ca;
+      o[3] = ab; o[4] = b; o[5] = bc;
+      o[6] = ca; o[7] = bc; o[8] = c;
+      o[9] = ab; o[10] = bc; o[11] = ca;
+    }
+
+    nv += ne;
+    nt *= 4;
+  }
+
+  // Back to the mesh
+  const std::vector<double>& q = p[levels & 1];
+  vertices.resize(nv);
+  attributes.resize(size_t(nv) * m);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    vertices[i] = Vector(q[size_t(i) * d], q[size_t(i) * d + 1], q[size_t(i) * d + 2]);
+    for (int k = 0; k < m; k++)
+    {
+      attributes[size_t(i) * m + k] = q[size_t(i) * d + 3 + k];
+    }
+  }
+  varray.swap(t[levels & 1]);
+  Modified();
+
+  if (m > 0)
+  {
+    SetVertexAttributes(attributes, m);
+  }
+  SmoothNormals();
+}
@@ -0,0 +1,180 @@
+// Welding
+
+#include "mesh.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+/*!
+\brief Merge the vertices closer than a given tolerance and remove the degenerate triangles.
+
+Vertices are hashed into a uniform grid whose cells are at least as large as the tolerance,
+keyed by their quantized coordinates, and sorted by cell with a parallel radix sort. Every
+vertex is then merged with the vertex of lowest index within the tolerance found in the
+neighboring cells, and merge chains are collapsed by pointer jumping, so that all the
+passes run in parallel and the result does not depend on the number of threads.
+
+Vertex and normal indexes are remapped, normals indexed like the vertices are merged with
+them, and triangles with two identical vertices after merging are removed. Vertices that
+are not referenced by any triangle are kept. Normals should be recomputed afterwards with
+Mesh::SmoothNormals() if the mesh was a triangle soup.
+\param tolerance Distance tolerance, vertices with identical coordinates are merged if null.
+*/
+void Mesh::Weld(double tolerance)
+{
+  const int nv = Vertexes();
+  const int nt = Triangles();
+  if (nv == 0)
+    return;
+
+  // Quantization grid, 21 bits per axis
+  const int bits = 21;
+  const double cells = double((1 << bits) - 2);
+  const Box box = GetBox();
+  const Vector diagonal = box.Diagonal();
+  const double extent = Math::Max(diagonal[0], diagonal[1], diagonal[2]);
+  const double size = Math::Max(tolerance, extent / cells) * (1.0 + 1e-6) + 1e-300;
+  const double t2 = tolerance * tolerance;
+
+  // Cell coordinates packed into a key, with an offset of one cell so that neighbors are never negative
+  auto cell = [&](const Vector& p, int j) -> unsigned long long
+  {
+    return (unsigned long long)((p[j] - box[0][j]) / size) + 1;
+  };
+  auto pack = [&](unsigned long long x, unsigned long long y, unsigned long long z) -> unsigned long long
+  {
+    return (x << (2 * bits)) | (y << bits) | z;
+  };
+
+  std::vector<unsigned long long> keys(nv);
+  std::vector<int> order(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    keys[i] = pack(cell(vertices[i], 0), cell(vertices[i], 1), cell(vertices[i], 2));
+    order[i] = i;
+  }
+  Parallel::RadixSort(keys, order);
+
+  // Lowest vertex within tolerance in the 27 neighboring cells
+  // Cells that differ only along z are contiguous, so that nine ranges are searched
+  std::vector<int> rep(nv);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (int i = 0; i < nv; i++)
+  {
+    if (i != 0 && keys[i] == keys[i - 1])
+      continue;
+
+    // Run of vertices in the cell
+    int end = i + 1;
+    while (end < nv && keys[end] == keys[i])
+    {
+      end++;
+    }
+
+    const unsigned long long mask = (1ull << bits) - 1;
+    const unsigned long long x = keys[i] >> (2 * bits);
+    const unsigned long long y = (keys[i] >> bits) & mask;
+    const unsigned long long z = keys[i] & mask;
+
+    int range[9][2];
+    for (int k = 0; k < 9; k++)
+    {
+      const unsigned long long cx = x + (k / 3) - 1;
+      const unsigned long long cy = y + (k % 3) - 1;
+      range[k][0] = int(std::lower_bound(keys.begin(), keys.end(), pack(cx, cy, z - 1)) - keys.begin());
+      range[k][1] = int(std::upper_bound(keys.begin() + range[k][0], keys.end(), pack(cx, cy, z + 1)) - keys.begin());
+    }
+
+    for (int a = i; a < end; a++)
+    {
+      const Vector& p = vertices[order[a]];
+      int r = order[a];
+      for (int k = 0; k < 9; k++)
+      {
+        for (int b = range[k][0]; b < range[k][1]; b++)
+        {
+          if (order[b] < r && SquaredNorm(vertices[order[b]] - p) <= t2)
+          {
+            r = order[b];
+          }
+        }
+      }
+      rep[order[a]] = r;
+    }
+  }
+
+  keys = std::vector<unsigned long long>();
+  order = std::vector<int>();
+
+  // Collapse chains, representatives have a lower index so that pointer jumping converges
+  std::vector<int> next(nv);
+  int changed = 1;
+  while (changed != 0)
+  {
+    changed = 0;
+#pragma omp parallel for schedule(static) reduction(+:changed)
+    for (int i = 0; i < nv; i++)
+    {
+      next[i] = rep[rep[i]];
+      if (next[i] != rep[i])
+      {
+        changed++;
+      }
+    }
+    rep.swap(next);
+  }
+  next = std::vector<int>();
+
+  // New vertex indexes
+  std::vector<int> vertexes(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    vertexes[i] = (rep[i] == i) ? 1 : 0;
+  }
+  const int n = Parallel::ExclusiveScan(vertexes);
+
+  std::vector<int> source(n);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    if (rep[i] == i)
+    {
+      source[vertexes[i]] = i;
+    }
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    if (rep[i] != i)
+    {
+      vertexes[i] = vertexes[rep[i]];
+    }
+  }
+
+  // Remaining triangles
+  std::vector<int> keep(nt);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    const int a = vertexes[varray[i * 3 + 0]];
+    const int b = vertexes[varray[i * 3 + 1]];
+    const int c = vertexes[varray[i * 3 + 2]];
+    keep[i] = (a != b && b != c && c != a) ? 1 : 0;
+  }
+  std::vector<int> index = keep;
+  const int m = Parallel::ExclusiveScan(index);
+
+  std::vector<int> triangles(m);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    if (keep[i])
+    {
+      triangles[index[i]] = i;
+    }
+  }
+
+  Remap(triangles, source, vertexes);
+}
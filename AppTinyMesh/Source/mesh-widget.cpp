@@ -37,9 +37,9 @@ MeshWidget::MeshGL::MeshGL(const Mesh& mesh, const Vector& position) : MeshGL()
     SetFrame(position);
     bbox = mesh.GetBox();
 
-    // Compute plain arrays of sorted vertices & normals
-    std::vector<int> vertexIndexes = mesh.VertexIndexes();
-    std::vector<int> normalIndexes = mesh.NormalIndexes();
+    // Compute plain arrays of sorted vertices & normals, indexes are not copied
+    const std::vector<int>& vertexIndexes = mesh.VertexIndexes();
+    const std::vector<int>& normalIndexes = mesh.NormalIndexes();
     assert(vertexIndexes.size() == normalIndexes.size());
 
     int nbVertex = int(vertexIndexes.size());
@@ -116,10 +116,10 @@ MeshWidget::MeshGL::MeshGL(const MeshColor& mesh, const Vector& fr) : MeshGL()
     SetFrame(fr);
     bbox = mesh.GetBox();
 
-    // Compute plain arrays of sorted vertices & normals
-    std::vector<int> vertexIndexes = mesh.VertexIndexes();
-    std::vector<int> normalIndexes = mesh.NormalIndexes();
-    std::vector<int> colorIndexes = mesh.ColorIndexes();
+    // Compute plain arrays of sorted vertices & normals, indexes are not copied
+    const std::vector<int>& vertexIndexes = mesh.VertexIndexes();
+    const std::vector<int>& normalIndexes = mesh.NormalIndexes();
+    const std::vector<int>& colorIndexes = mesh.ColorIndexes();
     assert(vertexIndexes.size() == normalIndexes.size());
 
     int nbVertex = int(vertexIndexes.size());
@@ -215,31 +215,39 @@ void MeshWidget::MeshGL::Delete()
 }
 
 /*!
-\brief
+\brief Set the frame as a translation.
+\param fr Translation.
 */
 void MeshWidget::MeshGL::SetFrame(const Vector& fr)
 {
-    // Rotation and scale
-    TRSMatrix[0] = 1.0f;
-    TRSMatrix[1] = 0.0f;
-    TRSMatrix[2] = 0.0f;
-    TRSMatrix[4] = 0.0f;
-    TRSMatrix[5] = 1.0f;
-    TRSMatrix[6] = 0.0f;
-    TRSMatrix[8] = 0.0f;
-    TRSMatrix[9] = 0.0f;
-    TRSMatrix[10] = 1.0f;
-
-    // Translation
-    TRSMatrix[12] = fr[0];
-    TRSMatrix[13] = fr[1];
-    TRSMatrix[14] = fr[2];
+    SetFrame(Frame::Translation(fr));
+}
 
-    // Shear
-    TRSMatrix[3] = TRSMatrix[7] = TRSMatrix[11] = 0.0;
+/*!
+\brief Set the frame.
 
-    // Scale
-    TRSMatrix[15] = 1.0;
+The Translation-Rotation-Scale Matrix is stored in column-major order, and normals
+are transformed by the inverse transpose of its linear part.
+\param frame Frame.
+*/
+void MeshWidget::MeshGL::SetFrame(const Frame& frame)
+{
+    const Frame normal = frame.NormalFrame();
+    for (int j = 0; j < 4; j++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            TRSMatrix[j * 4 + i] = float(frame(i, j));
+        }
+        TRSMatrix[j * 4 + 3] = j == 3 ? 1.0f : 0.0f;
+    }
+    for (int j = 0; j < 3; j++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            NormalMatrix[j * 3 + i] = float(normal(i, j));
+        }
+    }
 }
 
 
@@ -395,6 +403,7 @@ void MeshWidget::paintGL()
         // Uniforms
         glUniform2f(glGetUniformLocation(mainShaderProgram, "WIN_SCALE"), width() / 2.0f, height() / 2.0f);
         glUniformMatrix4fv(glGetUniformLocation(mainShaderProgram, "TRSMatrix"), 1, GL_FALSE, &i.value()->TRSMatrix[0]);
+        glUniformMatrix3fv(glGetUniformLocation(mainShaderProgram, "NormalMatrix"), 1, GL_FALSE, &i.value()->NormalMatrix[0]);
         glUniform1i(glGetUniformLocation(mainShaderProgram, "useWireframe"), i.value()->useWireframe ? 1 : 0);
         glUniform1i(glGetUniformLocation(mainShaderProgram, "material"), (int)i.value()->material);
         glUniform1i(glGetUniformLocation(mainShaderProgram, "shading"), (int)i.value()->shading);
@@ -464,6 +473,18 @@ void MeshWidget::UpdateMesh(const QString& name, const Vector& frame)
         objects[name]->SetFrame(frame);
 }
 
+/*!
+\brief Update the frame of a mesh given its name.
+\param name Mesh name.
+\param frame Frame.
+*/
+void MeshWidget::UpdateMesh(const QString& name, const Frame& frame)
+{
+    makeCurrent();
+    if (objects.contains(name))
+        objects[name]->SetFrame(frame);
+}
+
 /*!
 \brief Enable a mesh given its name.
 \param name mesh name
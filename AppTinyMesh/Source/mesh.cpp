@@ -1,4 +1,10 @@
 #include "mesh.h"
+#include "parallel.h"
+#include "topology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
 
 /*!
 \class Mesh mesh.h
@@ -39,6 +45,28 @@ Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<Vector>& norma
 {
 }
 
+/*!
+\brief Initialize the mesh from a list of vertices and a list of triangles, taking ownership of the arrays.
+\param vertices List of geometry vertices.
+\param indices List of indices wich represent the geometry triangles.
+*/
+Mesh::Mesh(std::vector<Vector>&& vertices, std::vector<int>&& indices) :vertices(std::move(vertices)), varray(std::move(indices))
+{
+  normals.resize(this->vertices.size(), Vector::Z);
+}
+
+/*!
+\brief Create the mesh, taking ownership of the arrays.
+
+This avoids copying the arrays, for instance when polygonizing large meshes.
+\param vertices Array of vertices.
+\param normals Array of normals.
+\param va, na Array of vertex and normal indexes.
+*/
+Mesh::Mesh(std::vector<Vector>&& vertices, std::vector<Vector>&& normals, std::vector<int>&& va, std::vector<int>&& na) :vertices(std::move(vertices)), normals(std::move(normals)), varray(std::move(va)), narray(std::move(na))
+{
+}
+
 /*!
 \brief Reserve memory for arrays.
 \param nv,nn,nvi,nvn Number of vertices, normals, vertex indexes and vertex normals.
@@ -62,28 +90,298 @@ Mesh::~Mesh()
 \brief Smooth the normals of the mesh.
 
 This function weights the normals of the faces by their corresponding area.
-\sa Triangle::AreaNormal()
+
+Normals are gathered per vertex from the vertex to triangle index rather than scattered
+from the triangles, so that both loops run in parallel without write conflicts. Triangles
+are summed in increasing order for every vertex, hence the result does not depend on the
+number of threads.
+\sa Triangle::AreaNormal(), Mesh::VertexTriangles()
 */
 void Mesh::SmoothNormals()
 {
-  // Initialize 
-  normals.resize(vertices.size(), Vector::Null);
+  const int nv = Vertexes();
+  const int nt = Triangles();
+
+  // Area weighted normals of the triangles, computed on all the lanes of the blocks so that the loops are vectorized
+  std::vector<Vector> tn(nt);
 
+  ForEachTriangleBlock([&](const TriangleBlock& block)
+    {
+      const int w = TriangleBlock::Width;
+      double e[2][3][w];
+      for (int k = 0; k < 2; k++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          const double* a = block.Coordinates(0, j);
+          const double* p = block.Coordinates(k + 1, j);
+          for (int l = 0; l < w; l++)
+          {
+            e[k][j][l] = p[l] - a[l];
+          }
+        }
+      }
+      double n[3][w];
+      for (int l = 0; l < w; l++)
+      {
+        n[0][l] = 0.5 * (e[0][1][l] * e[1][2][l] - e[0][2][l] * e[1][1][l]);
+        n[1][l] = 0.5 * (e[0][2][l] * e[1][0][l] - e[0][0][l] * e[1][2][l]);
+        n[2][l] = 0.5 * (e[0][0][l] * e[1][1][l] - e[0][1][l] * e[1][0][l]);
+      }
+      for (int l = 0; l < block.Size(); l++)
+      {
+        tn[block.Index(l)] = Vector(n[0][l], n[1][l], n[2][l]);
+      }
+    }, true);
+
+  std::vector<int> offset;
+  std::vector<int> triangles;
+  VertexTriangles(offset, triangles);
+
+  normals.resize(nv);
   narray = varray;
 
-  // Accumulate normals
-  for (int i = 0; i < varray.size(); i += 3)
+  // Gather and normalize
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
   {
-    Vector tn = Triangle(vertices[varray.at(i)], vertices[varray.at(i + 1)], vertices[varray.at(i + 2)]).AreaNormal();
-    normals[narray[i + 0]] += tn;
-    normals[narray[i + 1]] += tn;
-    normals[narray[i + 2]] += tn;
+    Vector n = Vector::Null;
+    for (int j = offset[i]; j < offset[i + 1]; j++)
+    {
+      n += tn[triangles[j]];
+    }
+    // Isolated vertices keep a null normal
+    double length = Norm(n);
+    normals[i] = length > 0.0 ? n / length : Vector::Null;
   }
+}
 
-  // Normalize 
-  for (int i = 0; i < normals.size(); i++)
+/*!
+\brief Compute the vertex to triangle adjacency in compressed sparse row form.
+
+The triangles sharing vertex i are triangles[offset[i]] to triangles[offset[i+1]-1],
+sorted in increasing order. A triangle appears once per corner, so a degenerate triangle
+with a repeated vertex is listed twice for that vertex.
+
+The index is built in parallel with a counting sort: vertex valences are counted with
+atomic increments, converted into offsets by a prefix sum, triangles are then scattered
+with atomic cursors, and every row is finally sorted.
+\param offset Returned array of offsets, with Vertexes()+1 entries.
+\param triangles Returned array of triangle indexes, with 3*Triangles() entries.
+*/
+void Mesh::VertexTriangles(std::vector<int>& offset, std::vector<int>& triangles) const
+{
+  const int nv = Vertexes();
+  const int nc = int(varray.size());
+
+  // Valence of the vertices, then cursors
+  std::unique_ptr<std::atomic<int>[]> cursor(new std::atomic<int>[nv]);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    cursor[i].store(0, std::memory_order_relaxed);
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nc; i++)
+  {
+    cursor[varray[i]].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  offset.resize(nv + 1);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    offset[i] = cursor[i].load(std::memory_order_relaxed);
+  }
+  offset[nv] = 0;
+  Parallel::ExclusiveScan(offset);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    cursor[i].store(offset[i], std::memory_order_relaxed);
+  }
+
+  // Scatter corners
+  triangles.resize(nc);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nc; i++)
+  {
+    triangles[cursor[varray[i]].fetch_add(1, std::memory_order_relaxed)] = i / 3;
+  }
+
+  // Sort rows, which are short, so that the order does not depend on scheduling
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    std::sort(triangles.begin() + offset[i], triangles.begin() + offset[i + 1]);
+  }
+}
+
+/*!
+\brief Return the topology of the mesh.
+
+The topology is built on the first call and cached until the triangles of the mesh change.
+It only depends on the vertex indexes, so it remains valid if vertices are moved.
+
+Note that the first call should not be made concurrently from several threads.
+\sa MeshTopology
+*/
+const MeshTopology& Mesh::Topology() const
+{
+  if (!topology)
+  {
+    topology = std::make_shared<const MeshTopology>(varray, Vertexes());
+  }
+  return *topology;
+}
+
+/*!
+\brief Compute the one-ring of a vertex, i.e. its neighbors in the order of the triangle fan.
+
+For non-manifold vertices, only the neighbors of the first fan are returned.
+\param v Vertex index.
+\param ring Returned neighbors.
+*/
+void Mesh::OneRing(int v, std::vector<int>& ring) const
+{
+  const MeshTopology& t = Topology();
+
+  ring.clear();
+
+  const int s = t.Outgoing(v);
+  if (s < 0)
+    return;
+
+  // Open fan: the first triangle has a boundary incoming edge, add its origin
+  if (t.CounterSwing(s) < 0)
+  {
+    ring.push_back(varray[MeshTopology::Prev(s)]);
+  }
+
+  int h = s;
+  do
+  {
+    ring.push_back(varray[MeshTopology::Next(h)]);
+    h = t.Swing(h);
+  } while (h >= 0 && h != s);
+}
+
+/*!
+\brief Notify that the triangles of the mesh changed, which discards the cached topology.
+*/
+void Mesh::Modified()
+{
+  topology.reset();
+}
+
+/*!
+\brief Rebuild the mesh from a subset of its triangles and a renumbering of its vertices.
+
+This is the common back end of the processing functions that reorder, merge or remove
+vertices and triangles. Normals stored per vertex, i.e. as many normals as vertices with
+either the same indexes as the vertices or no indexes at all, are renumbered along with the
+vertices; otherwise they are left unchanged and only their indexes are gathered with the triangles.
+
+Derived classes override this function to carry their own attributes over.
+\param triangles Triangles of the new mesh, given as indexes of the triangles of the mesh.
+\param source Vertices of the new mesh, given as indexes of the vertices of the mesh.
+\param vertexes New index of every vertex of the mesh, -1 for removed vertices.
+*/
+void Mesh::Remap(const std::vector<int>& triangles, const std::vector<int>& source, const std::vector<int>& vertexes)
+{
+  const int nt = int(triangles.size());
+  const int nv = int(source.size());
+
+  const bool vertexNormals = (normals.size() == vertices.size()) && (narray.empty() || narray == varray);
+  const bool hasNormals = !narray.empty();
+
+  std::vector<Vector> v(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    v[i] = vertices[source[i]];
+  }
+
+  std::vector<int> va(nt * 3);
+  std::vector<int> na(hasNormals ? nt * 3 : 0);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    const int t = triangles[i];
+    for (int j = 0; j < 3; j++)
+    {
+      va[i * 3 + j] = vertexes[varray[t * 3 + j]];
+      if (hasNormals)
+      {
+        na[i * 3 + j] = vertexNormals ? va[i * 3 + j] : narray[t * 3 + j];
+      }
+    }
+  }
+
+  if (vertexNormals)
+  {
+    std::vector<Vector> n(nv);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      n[i] = normals[source[i]];
+    }
+    normals.swap(n);
+  }
+
+  vertices.swap(v);
+  varray.swap(va);
+  narray.swap(na);
+  Modified();
+}
+
+/*!
+\brief Get the attributes interpolated along with the vertices, i.e. the normals if they are indexed like the vertices.
+\param attributes Returned attributes, stored per vertex.
+\return The number of attributes per vertex.
+\sa Mesh::SetVertexAttributes()
+*/
+int Mesh::VertexAttributes(std::vector<double>& attributes) const
+{
+  attributes.clear();
+  if (narray != varray || normals.size() != vertices.size())
+    return 0;
+
+  const int nv = Vertexes();
+  attributes.resize(nv * 3);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      attributes[i * 3 + j] = normals[i][j];
+    }
+  }
+  return 3;
+}
+
+/*!
+\brief Set the attributes of the vertices, the inverse of Mesh::VertexAttributes().
+
+Normals are normalized.
+\param attributes Attributes, stored per vertex.
+\param n Number of attributes per vertex, the ones of the mesh come first.
+*/
+void Mesh::SetVertexAttributes(const std::vector<double>& attributes, int n)
+{
+  if (narray != varray || normals.size() != vertices.size())
+    return;
+
+  const int nv = Vertexes();
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
   {
-    Normalize(normals[i]);
+    const Vector normal(attributes[i * n], attributes[i * n + 1], attributes[i * n + 2]);
+    const double length = Norm(normal);
+    normals[i] = length > 0.0 ? normal / length : Vector::Null;
   }
 }
 
@@ -94,6 +392,7 @@ void Mesh::SmoothNormals()
 */
 void Mesh::AddSmoothTriangle(int a, int na, int b, int nb, int c, int nc)
 {
+  Modified();
   varray.push_back(a);
   narray.push_back(na);
   varray.push_back(b);
@@ -109,6 +408,7 @@ void Mesh::AddSmoothTriangle(int a, int na, int b, int nb, int c, int nc)
 */
 void Mesh::AddTriangle(int a, int b, int c, int n)
 {
+  Modified();
   varray.push_back(a);
   narray.push_back(n);
   varray.push_back(b);
@@ -242,6 +542,7 @@ void Mesh::Load(const QString& filename)
   normals.clear();
   varray.clear();
   narray.clear();
+  Modified();
 
   QFile data(filename);
 
@@ -0,0 +1,1499 @@
+// Bounding volume hierarchy
+
+#include "meshbvh.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <queue>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/*!
+\class MeshBVH meshbvh.h
+\brief Bounding volume hierarchy over the triangles of a mesh.
+
+The hierarchy is built top-down with the surface area heuristic evaluated over a fixed number of
+bins along every axis. The top levels are split one node at a time with the binning of every node
+parallelized over its triangles, and once there are enough nodes the remaining subtrees are built
+in parallel, every one of them by a single thread.
+
+Nodes are stored in a flat array in depth first order, one cache line per node, so that the first
+child of an internal node is the next node. Vertices of the triangles are copied in leaf order,
+so that the triangles of a leaf are contiguous in memory.
+\code
+MeshBVH bvh(mesh);
+double t, u, v;
+int i;
+if (bvh.Intersect(ray, t, u, v, i)) // Closest intersection with triangle i
+{
+  Vector p = ray(t);
+}
+\endcode
+*/
+
+/*!
+\brief Round a vector to single precision.
+\param p Vector.
+*/
+static inline Vector MeshBVHRound(const Vector& p)
+{
+  return Vector(float(p[0]), float(p[1]), float(p[2]));
+}
+
+// Bin of the surface area heuristic
+class MeshBVHBin
+{
+public:
+  Vector a = Vector(Math::Infinity), b = Vector(-Math::Infinity); //!< Box of the triangles.
+  int n = 0;                                                       //!< Number of triangles.
+public:
+  //! Area of the box, zero if empty.
+  double Area() const
+  {
+    if (n == 0)
+      return 0.0;
+    const Vector d = b - a;
+    return d[0] * d[1] + d[0] * d[2] + d[1] * d[2];
+  }
+};
+
+// Box of a triangle, partitioned in place with the others so that ranges are read sequentially
+class MeshBVHReference
+{
+public:
+  Vector a, b; //!< Box of the triangle.
+  int index;   //!< Triangle index.
+public:
+  //! Twice the center of the box.
+  Vector Center() const
+  {
+    return a + b;
+  }
+};
+
+// Top-down construction over an array of triangle references
+class MeshBVHBuilder
+{
+public:
+  std::vector<MeshBVHReference>& references; //!< Triangle references.
+public:
+  //! Creates a builder.
+  explicit MeshBVHBuilder(std::vector<MeshBVHReference>& r) :references(r) {}
+
+  static int Slot(double);
+  static int Blocks(int);
+  void Bound(int, int, Vector&, Vector&, Vector&, Vector&) const;
+  void Bounds(int, int, bool, Vector&, Vector&, Vector&, Vector&) const;
+  void Bin(int, int, const Vector&, const double*, MeshBVHBin*) const;
+  int Split(int, int, int, const Vector&, const Vector&, bool, int&);
+  int Build(int, int, int, std::vector<MeshBVHNode>&);
+};
+
+/*!
+\brief Compute the bin of a center.
+\param x Scaled distance of the center to the lower vertex of the box of the centers.
+*/
+inline int MeshBVHBuilder::Slot(double x)
+{
+  const int s = int(x);
+  return s < MeshBVH::Bins ? s : MeshBVH::Bins - 1;
+}
+
+/*!
+\brief Compute the number of blocks of triangles needed for a given number of triangles.
+\param n Number of triangles.
+*/
+inline int MeshBVHBuilder::Blocks(int n)
+{
+  return (n + MeshBVH::LeafSize - 1) / MeshBVH::LeafSize;
+}
+
+/*!
+\brief Compute the box of the triangles and the box of their centers over a range, serially.
+\param first, last Range of the triangles.
+\param a, b Box of the triangles.
+\param ca, cb Box of the centers.
+*/
+void MeshBVHBuilder::Bound(int first, int last, Vector& a, Vector& b, Vector& ca, Vector& cb) const
+{
+  a = ca = Vector(Math::Infinity);
+  b = cb = Vector(-Math::Infinity);
+  for (int i = first; i < last; i++)
+  {
+    const MeshBVHReference& r = references[i];
+    const Vector c = r.Center();
+    a = Vector::Min(a, r.a);
+    b = Vector::Max(b, r.b);
+    ca = Vector::Min(ca, c);
+    cb = Vector::Max(cb, c);
+  }
+}
+
+/*!
+\brief Compute the box of the triangles and the box of their centers over a range.
+\param first, last Range of the triangles.
+\param parallel Reduce in parallel.
+\param a, b Box of the triangles.
+\param ca, cb Box of the centers.
+*/
+void MeshBVHBuilder::Bounds(int first, int last, bool parallel, Vector& a, Vector& b, Vector& ca, Vector& cb) const
+{
+  if (!parallel)
+  {
+    Bound(first, last, a, b, ca, cb);
+    return;
+  }
+
+  const int threads = Parallel::Threads();
+  std::vector<Vector> r(4 * threads);
+  int used = 1;
+
+#pragma omp parallel num_threads(threads)
+  {
+    int t = 0;
+    int nt = 1;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+#pragma omp single
+    used = nt;
+
+    const int begin = first + int((long long)(last - first) * t / nt);
+    const int end = first + int((long long)(last - first) * (t + 1) / nt);
+    Bound(begin, end, r[4 * t], r[4 * t + 1], r[4 * t + 2], r[4 * t + 3]);
+  }
+
+  a = r[0]; b = r[1]; ca = r[2]; cb = r[3];
+  for (int t = 1; t < used; t++)
+  {
+    a = Vector::Min(a, r[4 * t]);
+    b = Vector::Max(b, r[4 * t + 1]);
+    ca = Vector::Min(ca, r[4 * t + 2]);
+    cb = Vector::Max(cb, r[4 * t + 3]);
+  }
+}
+
+/*!
+\brief Accumulate a range of triangles into the bins of the three axes.
+\param first, last Range of the triangles.
+\param ca Lower vertex of the box of the centers.
+\param scale Number of bins per unit length along every axis.
+\param bins Bins, stored axis after axis.
+*/
+void MeshBVHBuilder::Bin(int first, int last, const Vector& ca, const double* scale, MeshBVHBin* bins) const
+{
+  for (int i = first; i < last; i++)
+  {
+    const MeshBVHReference& r = references[i];
+    const Vector c = r.Center();
+    for (int k = 0; k < 3; k++)
+    {
+      MeshBVHBin& bin = bins[k * MeshBVH::Bins + Slot(scale[k] * (c[k] - ca[k]))];
+      bin.a = Vector::Min(bin.a, r.a);
+      bin.b = Vector::Max(bin.b, r.b);
+      bin.n++;
+    }
+  }
+}
+
+/*!
+\brief Partition a range of triangles into two children.
+
+The split plane minimizes the surface area heuristic over the bins of the three axes. Triangles
+are intersected by blocks of MeshBVH::LeafSize, and intersecting a block costs as much as
+traversing a node, so that ranges that fit in a block are always leaves. Ranges whose centers
+coincide, and ranges deeper than MeshBVH::MaxDepth, are split at the median so that the depth
+remains bounded.
+\param first, last Range of the triangles.
+\param depth Depth of the node.
+\param ca, cb Box of the centers.
+\param parallel Bin in parallel.
+\param axis Split axis.
+\return The first triangle of the second child, or first if the range should be a leaf.
+*/
+int MeshBVHBuilder::Split(int first, int last, int depth, const Vector& ca, const Vector& cb, bool parallel, int& axis)
+{
+  const int n = last - first;
+  const Vector e = cb - ca;
+  axis = (e[0] >= e[1] && e[0] >= e[2]) ? 0 : (e[1] >= e[2] ? 1 : 2);
+  if (n <= MeshBVH::LeafSize)
+    return first;
+
+  // Median split
+  if (e[axis] <= 0.0 || depth >= MeshBVH::MaxDepth)
+  {
+    const int mid = first + n / 2;
+    const int k = axis;
+    std::nth_element(references.begin() + first, references.begin() + mid, references.begin() + last, [k](const MeshBVHReference& p, const MeshBVHReference& q) { return p.Center()[k] < q.Center()[k]; });
+    return mid;
+  }
+
+  // Binning along the three axes
+  double scale[3];
+  for (int k = 0; k < 3; k++)
+  {
+    scale[k] = e[k] > 0.0 ? MeshBVH::Bins / e[k] : 0.0;
+  }
+
+  MeshBVHBin bins[3 * MeshBVH::Bins];
+  if (!parallel)
+  {
+    Bin(first, last, ca, scale, bins);
+  }
+  else
+  {
+    const int threads = Parallel::Threads();
+    std::vector<MeshBVHBin> partial(size_t(threads) * 3 * MeshBVH::Bins);
+    int used = 1;
+
+#pragma omp parallel num_threads(threads)
+    {
+      int t = 0;
+      int nt = 1;
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+      nt = omp_get_num_threads();
+#endif
+#pragma omp single
+      used = nt;
+
+      const int begin = first + int((long long)(n) * t / nt);
+      const int end = first + int((long long)(n) * (t + 1) / nt);
+      Bin(begin, end, ca, scale, &partial[size_t(t) * 3 * MeshBVH::Bins]);
+    }
+    for (int t = 0; t < used; t++)
+    {
+      for (int s = 0; s < 3 * MeshBVH::Bins; s++)
+      {
+        MeshBVHBin& c = bins[s];
+        const MeshBVHBin& d = partial[size_t(t) * 3 * MeshBVH::Bins + s];
+        c.a = Vector::Min(c.a, d.a);
+        c.b = Vector::Max(c.b, d.b);
+        c.n += d.n;
+      }
+    }
+  }
+
+  // Sweep, costs are scaled by the area of the node
+  double best = Math::Infinity;
+  int split = -1;
+  for (int k = 0; k < 3; k++)
+  {
+    if (e[k] <= 0.0)
+      continue;
+    const MeshBVHBin* bin = &bins[k * MeshBVH::Bins];
+
+    double right[MeshBVH::Bins];
+    MeshBVHBin r;
+    for (int s = MeshBVH::Bins - 1; s > 0; s--)
+    {
+      r.a = Vector::Min(r.a, bin[s].a);
+      r.b = Vector::Max(r.b, bin[s].b);
+      r.n += bin[s].n;
+      right[s] = r.Area() * Blocks(r.n);
+    }
+    MeshBVHBin l;
+    for (int s = 0; s < MeshBVH::Bins - 1; s++)
+    {
+      l.a = Vector::Min(l.a, bin[s].a);
+      l.b = Vector::Max(l.b, bin[s].b);
+      l.n += bin[s].n;
+      if (l.n == 0 || l.n == n)
+        continue;
+      const double cost = l.Area() * Blocks(l.n) + right[s + 1];
+      if (cost < best)
+      {
+        best = cost;
+        axis = k;
+        split = s;
+      }
+    }
+  }
+
+  if (split == -1)
+  {
+    const int mid = first + n / 2;
+    const int k = axis;
+    std::nth_element(references.begin() + first, references.begin() + mid, references.begin() + last, [k](const MeshBVHReference& p, const MeshBVHReference& q) { return p.Center()[k] < q.Center()[k]; });
+    return mid;
+  }
+
+  const int k = axis;
+  const double s = scale[k];
+  const double o = ca[k];
+  const std::vector<MeshBVHReference>::iterator mid = std::partition(references.begin() + first, references.begin() + last, [=](const MeshBVHReference& r)
+    {
+      return Slot(s * (r.Center()[k] - o)) <= split;
+    });
+  return int(mid - references.begin());
+}
+
+/*!
+\brief Build the subtree of a range of triangles in depth first order.
+
+Indexes of the second children are relative to the first node of the subtree.
+\param first, last Range of the triangles.
+\param depth Depth of the root of the subtree.
+\param nodes Array of nodes, appended to.
+\return The depth of the deepest leaf.
+*/
+int MeshBVHBuilder::Build(int first, int last, int depth, std::vector<MeshBVHNode>& nodes)
+{
+  class Task
+  {
+  public:
+    int first, last, depth, parent;
+  };
+
+  const int origin = int(nodes.size());
+  int deepest = depth;
+  std::vector<Task> stack;
+  stack.push_back({ first, last, depth, -1 });
+  while (!stack.empty())
+  {
+    const Task t = stack.back();
+    stack.pop_back();
+
+    // The first child is the next node, the second child is linked to its parent
+    const int k = int(nodes.size());
+    if (t.parent != -1)
+    {
+      nodes[t.parent].index = k - origin;
+    }
+
+    Vector a, b, ca, cb;
+    Bounds(t.first, t.last, false, a, b, ca, cb);
+    int axis;
+    const int mid = Split(t.first, t.last, t.depth, ca, cb, false, axis);
+
+    MeshBVHNode node;
+    node.box = Box(a, b);
+    node.axis = axis;
+    if (mid == t.first)
+    {
+      node.index = t.first;
+      node.count = t.last - t.first;
+      deepest = Math::Max(deepest, t.depth + 1);
+    }
+    else
+    {
+      node.index = -1;
+      node.count = 0;
+      stack.push_back({ mid, t.last, t.depth + 1, k });
+      stack.push_back({ t.first, mid, t.depth + 1, -1 });
+    }
+    nodes.push_back(node);
+  }
+  return deepest;
+}
+
+/*!
+\brief Build the hierarchy of the triangles of a mesh.
+\param mesh The mesh.
+*/
+MeshBVH::MeshBVH(const Mesh& mesh)
+{
+  const int nt = mesh.Triangles();
+  if (nt == 0)
+    return;
+
+  // Boxes of the triangles, which should enclose the triangles of the blocks in single precision
+  const Vector* v = mesh.Vertices().data();
+  const int* va = mesh.VertexIndexes().data();
+  std::vector<MeshBVHReference> references(nt);
+#pragma omp parallel for schedule(static) if(nt >= Parallel::Grain)
+  for (int i = 0; i < nt; i++)
+  {
+    const Vector p = MeshBVHRound(v[va[3 * i]]);
+    const Vector q = MeshBVHRound(v[va[3 * i + 1]]);
+    const Vector r = MeshBVHRound(v[va[3 * i + 2]]);
+    references[i].a = Vector::Min(p, Vector::Min(q, r));
+    references[i].b = Vector::Max(p, Vector::Max(q, r));
+    references[i].index = i;
+  }
+
+  MeshBVHBuilder builder(references);
+  const int threads = nt < Parallel::Grain ? 1 : Parallel::Threads();
+  if (threads == 1)
+  {
+    depth = builder.Build(0, nt, 0, nodes);
+  }
+  else
+  {
+    // Top nodes, split one at a time with parallel binning until ranges are small enough for a single thread
+    class Top
+    {
+    public:
+      MeshBVHNode node;
+      int first, last, depth;
+      int child[2] = { -1, -1 }; //!< Children in the array of top nodes.
+      int subtree = -1;          //!< Subtree built by a single thread, if any.
+      int position = 0;          //!< Position in the flattened array.
+    };
+    std::vector<Top> top(1);
+    top[0].first = 0;
+    top[0].last = nt;
+    top[0].depth = 0;
+
+    const int small = Math::Max(nt / (8 * threads), Parallel::Grain / 4);
+    std::vector<int> roots;
+    for (int k = 0; k < int(top.size()); k++)
+    {
+      if (top[k].last - top[k].first <= small)
+      {
+        top[k].subtree = int(roots.size());
+        roots.push_back(k);
+        continue;
+      }
+      Vector a, b, ca, cb;
+      builder.Bounds(top[k].first, top[k].last, true, a, b, ca, cb);
+      int axis;
+      const int mid = builder.Split(top[k].first, top[k].last, top[k].depth, ca, cb, true, axis);
+      top[k].node.box = Box(a, b);
+      top[k].node.axis = axis;
+      top[k].node.count = 0;
+
+      Top l, r;
+      l.first = top[k].first;
+      l.last = r.first = mid;
+      r.last = top[k].last;
+      l.depth = r.depth = top[k].depth + 1;
+      top[k].child[0] = int(top.size());
+      top[k].child[1] = int(top.size()) + 1;
+      top.push_back(l);
+      top.push_back(r);
+    }
+
+    // Subtrees, largest first
+    std::vector<std::vector<MeshBVHNode>> subtrees(roots.size());
+    std::vector<int> depths(roots.size());
+    std::vector<int> order(roots.size());
+    for (int i = 0; i < int(roots.size()); i++)
+    {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int i, int j) { return top[roots[i]].last - top[roots[i]].first > top[roots[j]].last - top[roots[j]].first; });
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < int(roots.size()); i++)
+    {
+      const int s = order[i];
+      const Top& t = top[roots[s]];
+      depths[s] = builder.Build(t.first, t.last, t.depth, subtrees[s]);
+    }
+
+    // Positions in depth first order, the top nodes are stored after their parent
+    std::vector<int> stack(1, 0);
+    int size = 0;
+    while (!stack.empty())
+    {
+      const int k = stack.back();
+      stack.pop_back();
+      top[k].position = size;
+      if (top[k].subtree != -1)
+      {
+        size += int(subtrees[top[k].subtree].size());
+        depth = Math::Max(depth, depths[top[k].subtree]);
+      }
+      else
+      {
+        size++;
+        stack.push_back(top[k].child[1]);
+        stack.push_back(top[k].child[0]);
+      }
+    }
+
+    nodes.resize(size);
+    for (int k = 0; k < int(top.size()); k++)
+    {
+      if (top[k].subtree == -1)
+      {
+        nodes[top[k].position] = top[k].node;
+        nodes[top[k].position].index = top[top[k].child[1]].position;
+      }
+    }
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < int(roots.size()); s++)
+    {
+      const std::vector<MeshBVHNode>& subtree = subtrees[s];
+      const int offset = top[roots[s]].position;
+      for (int i = 0; i < int(subtree.size()); i++)
+      {
+        MeshBVHNode& node = nodes[offset + i];
+        node = subtree[i];
+        if (node.count == 0)
+        {
+          node.index += offset;
+        }
+      }
+    }
+  }
+
+  // Triangles and their vertices in leaf order
+  index.resize(nt);
+  vertices.resize(3 * size_t(nt));
+#pragma omp parallel for schedule(static) if(nt >= Parallel::Grain)
+  for (int i = 0; i < nt; i++)
+  {
+    index[i] = references[i].index;
+    for (int k = 0; k < 3; k++)
+    {
+      vertices[3 * size_t(i) + k] = v[va[3 * index[i] + k]];
+    }
+  }
+
+  // Blocks of triangles, boxes and costs of the subtrees
+  Gather();
+  Fit(costs);
+}
+
+/*!
+\brief Gather the triangles of every leaf into one block of triangles.
+*/
+void MeshBVH::Gather()
+{
+  int n = 0;
+  for (int k = 0; k < int(nodes.size()); k++)
+  {
+    nodes[k].block = nodes[k].count != 0 ? n++ : -1;
+  }
+  blocks.resize(n);
+#pragma omp parallel for schedule(static) if(int(nodes.size()) >= Parallel::Grain / 16)
+  for (int k = 0; k < int(nodes.size()); k++)
+  {
+    const MeshBVHNode& node = nodes[k];
+    if (node.count != 0)
+    {
+      blocks[node.block].Gather(vertices.data(), node.index, node.count);
+    }
+  }
+}
+
+/*!
+\brief Compute the boxes of the nodes bottom-up from the vertices of the triangles.
+
+Nodes are grouped by depth, and the levels are processed from the deepest one to the root with
+a parallel loop over the nodes of every level. Boxes of the leaves enclose the vertices rounded
+to single precision, and are padded by a few units in the last place in single precision so that
+the slab tests never miss the triangles that the single precision intersection hits near the
+edges of the boxes.
+
+The depth of the hierarchy is updated.
+\param cost Relative cost of the subtrees with the surface area heuristic, see Cost().
+*/
+void MeshBVH::Fit(std::vector<double>& cost)
+{
+  const int n = int(nodes.size());
+  cost.resize(n);
+  if (n == 0)
+    return;
+
+  // Depth of the nodes, parents are stored before their children
+  std::vector<int> level(n);
+  level[0] = 0;
+  depth = 1;
+  for (int k = 0; k < n; k++)
+  {
+    if (nodes[k].count == 0)
+    {
+      level[k + 1] = level[nodes[k].index] = level[k] + 1;
+      depth = Math::Max(depth, level[k] + 2);
+    }
+  }
+
+  // Nodes sorted by depth
+  std::vector<int> start(depth + 1, 0);
+  for (int k = 0; k < n; k++)
+  {
+    start[level[k] + 1]++;
+  }
+  for (int l = 0; l < depth; l++)
+  {
+    start[l + 1] += start[l];
+  }
+  std::vector<int> order(n);
+  std::vector<int> next(start.begin(), start.end() - 1);
+  for (int k = 0; k < n; k++)
+  {
+    order[next[level[k]]++] = k;
+  }
+
+  // Boxes and absolute costs, deepest level first
+  std::vector<double> area(n);
+  for (int l = depth - 1; l >= 0; l--)
+  {
+#pragma omp parallel for schedule(static) if(start[l + 1] - start[l] >= Parallel::Grain / 16)
+    for (int j = start[l]; j < start[l + 1]; j++)
+    {
+      const int k = order[j];
+      MeshBVHNode& node = nodes[k];
+      if (node.count != 0)
+      {
+        Vector a(Math::Infinity), b(-Math::Infinity);
+        for (int i = 3 * node.index; i < 3 * (node.index + node.count); i++)
+        {
+          const Vector p = MeshBVHRound(vertices[i]);
+          a = Vector::Min(a, p);
+          b = Vector::Max(b, p);
+        }
+        const Vector e = 1e-6 * (Vector::Max(Abs(a), Abs(b)) + (b - a));
+        node.box = Box(a - e, b + e);
+      }
+      else
+      {
+        const Box& l = nodes[k + 1].box;
+        const Box& r = nodes[node.index].box;
+        node.box = Box(Vector::Min(l[0], r[0]), Vector::Max(l[1], r[1]));
+      }
+      const Vector d = node.box.Diagonal();
+      area[k] = d[0] * d[1] + d[0] * d[2] + d[1] * d[2];
+      cost[k] = node.count != 0 ? area[k] : area[k] + cost[k + 1] + cost[node.index];
+    }
+  }
+
+#pragma omp parallel for schedule(static) if(n >= Parallel::Grain)
+  for (int k = 0; k < n; k++)
+  {
+    cost[k] = area[k] > 0.0 ? cost[k] / area[k] : 1.0;
+  }
+}
+
+/*!
+\brief Update the hierarchy after the vertices of the mesh moved.
+
+The triangles are unchanged, and the boxes of the nodes are updated bottom-up in parallel, which
+is much faster than building a new hierarchy, but the quality of the hierarchy degrades as the
+triangles move away from each other. Subtrees whose relative cost with the surface area heuristic
+exceeds their cost when they were built by a given factor are optionally rebuilt.
+\code
+MeshBVH bvh(mesh);
+mesh.Smooth(1);
+bvh.Refit(mesh, 1.5); // Rebuild the subtrees whose cost increased by 50%
+\endcode
+\param mesh The mesh, with the same triangles as when the hierarchy was built.
+\param threshold Factor of the cost beyond which subtrees are rebuilt, no subtree is rebuilt if negative or null.
+\return The number of rebuilt subtrees.
+*/
+int MeshBVH::Refit(const Mesh& mesh, double threshold)
+{
+  const int nt = Triangles();
+  if (nt == 0)
+    return 0;
+
+  const Vector* v = mesh.Vertices().data();
+  const int* va = mesh.VertexIndexes().data();
+#pragma omp parallel for schedule(static) if(nt >= Parallel::Grain)
+  for (int i = 0; i < nt; i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      vertices[3 * size_t(i) + k] = v[va[3 * index[i] + k]];
+    }
+  }
+  Gather();
+  std::vector<double> cost;
+  Fit(cost);
+  if (threshold <= 0.0)
+    return 0;
+
+  // Topmost degraded subtrees in depth first order, with their depth
+  std::vector<int> roots, levels;
+  std::vector<int> stack(1, 0);
+  std::vector<int> depths(1, 0);
+  while (!stack.empty())
+  {
+    const int k = stack.back();
+    const int l = depths.back();
+    stack.pop_back();
+    depths.pop_back();
+    if (nodes[k].count != 0)
+      continue;
+    if (cost[k] > threshold * costs[k])
+    {
+      roots.push_back(k);
+      levels.push_back(l);
+      continue;
+    }
+    stack.push_back(nodes[k].index);
+    stack.push_back(k + 1);
+    depths.push_back(l + 1);
+    depths.push_back(l + 1);
+  }
+  if (roots.size() == 1 && roots[0] == 0)
+  {
+    // The whole hierarchy, built with parallel binning at the top
+    const bool w = watertight;
+    *this = MeshBVH(mesh);
+    watertight = w;
+  }
+  else if (!roots.empty())
+  {
+    Rebuild(roots, levels);
+  }
+  return int(roots.size());
+}
+
+/*!
+\brief Rebuild some subtrees of the hierarchy.
+
+Every subtree spans a contiguous range of nodes, and of triangles in leaf order, so that it is
+rebuilt in place over the same triangles. Subtrees are rebuilt in parallel, and the nodes are
+then copied with the new subtrees in place of the old ones.
+\param roots Roots of disjoint subtrees, in depth first order.
+\param levels Depth of the roots.
+*/
+void MeshBVH::Rebuild(const std::vector<int>& roots, const std::vector<int>& levels)
+{
+  const int r = int(roots.size());
+  std::vector<std::vector<MeshBVHNode>> subtrees(r);
+  std::vector<int> ends(r);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int s = 0; s < r; s++)
+  {
+    // Leftmost and rightmost leaves, the latter being the last node of the subtree
+    int p = roots[s];
+    while (nodes[p].count == 0)
+    {
+      p++;
+    }
+    const int first = nodes[p].index;
+    p = roots[s];
+    while (nodes[p].count == 0)
+    {
+      p = nodes[p].index;
+    }
+    const int last = nodes[p].index + nodes[p].count;
+    ends[s] = p + 1;
+
+    const int m = last - first;
+    std::vector<MeshBVHReference> references(m);
+    for (int j = 0; j < m; j++)
+    {
+      const Vector* q = &vertices[3 * size_t(first + j)];
+      const Vector a = MeshBVHRound(q[0]), b = MeshBVHRound(q[1]), c = MeshBVHRound(q[2]);
+      references[j].a = Vector::Min(a, Vector::Min(b, c));
+      references[j].b = Vector::Max(a, Vector::Max(b, c));
+      references[j].index = first + j;
+    }
+    MeshBVHBuilder builder(references);
+    builder.Build(0, m, levels[s], subtrees[s]);
+    for (int i = 0; i < int(subtrees[s].size()); i++)
+    {
+      if (subtrees[s][i].count != 0)
+      {
+        subtrees[s][i].index += first;
+      }
+    }
+
+    // Triangles in the new leaf order, the range is not shared with other subtrees
+    std::vector<int> ix(m);
+    std::vector<Vector> vx(3 * size_t(m));
+    for (int j = 0; j < m; j++)
+    {
+      const int i = references[j].index;
+      ix[j] = index[i];
+      for (int k = 0; k < 3; k++)
+      {
+        vx[3 * size_t(j) + k] = vertices[3 * size_t(i) + k];
+      }
+    }
+    std::copy(ix.begin(), ix.end(), index.begin() + first);
+    std::copy(vx.begin(), vx.end(), vertices.begin() + 3 * size_t(first));
+  }
+
+  // Shift of the nodes stored after the first subtrees
+  std::vector<int> shift(r + 1, 0);
+  for (int s = 0; s < r; s++)
+  {
+    shift[s + 1] = shift[s] + int(subtrees[s].size()) - (ends[s] - roots[s]);
+  }
+
+  // Nodes with the new subtrees, the costs of the other nodes are kept
+  const int n = int(nodes.size());
+  std::vector<MeshBVHNode> result;
+  std::vector<double> cost;
+  result.reserve(n + shift[r]);
+  cost.reserve(n + shift[r]);
+  int s = 0;
+  for (int p = 0; p < n;)
+  {
+    if (s < r && p == roots[s])
+    {
+      const int offset = int(result.size());
+      for (int i = 0; i < int(subtrees[s].size()); i++)
+      {
+        MeshBVHNode node = subtrees[s][i];
+        if (node.count == 0)
+        {
+          node.index += offset;
+        }
+        result.push_back(node);
+        cost.push_back(-1.0);
+      }
+      p = ends[s];
+      s++;
+    }
+    else
+    {
+      MeshBVHNode node = nodes[p];
+      if (node.count == 0)
+      {
+        node.index += shift[std::lower_bound(roots.begin(), roots.end(), node.index) - roots.begin()];
+      }
+      result.push_back(node);
+      cost.push_back(costs[p]);
+      p++;
+    }
+  }
+  nodes.swap(result);
+
+  Gather();
+  Fit(costs);
+  for (int k = 0; k < int(nodes.size()); k++)
+  {
+    if (cost[k] >= 0.0)
+    {
+      costs[k] = cost[k];
+    }
+  }
+}
+
+/*!
+\brief Compute the cost of the hierarchy with the surface area heuristic.
+
+The cost is the expected number of nodes traversed and blocks of triangles intersected by a
+random ray hitting the box of the root, with the same cost for both operations.
+*/
+double MeshBVH::Cost() const
+{
+  if (nodes.empty())
+    return 0.0;
+
+  double cost = 0.0;
+  for (int i = 0; i < int(nodes.size()); i++)
+  {
+    const Vector d = nodes[i].GetBox().Diagonal();
+    const double area = d[0] * d[1] + d[0] * d[2] + d[1] * d[2];
+    cost += area;
+  }
+  const Vector d = nodes[0].GetBox().Diagonal();
+  const double area = d[0] * d[1] + d[0] * d[2] + d[1] * d[2];
+  return area > 0.0 ? cost / area : cost;
+}
+
+/*!
+\brief Compute the memory used by the hierarchy in bytes.
+*/
+size_t MeshBVH::Memory() const
+{
+  return sizeof(MeshBVH) + nodes.size() * sizeof(MeshBVHNode) + index.size() * sizeof(int) + vertices.size() * sizeof(Vector) + blocks.size() * sizeof(TriangleBlockF) + costs.size() * sizeof(double);
+}
+
+/*!
+\brief Compute the intersection depth and the parametric coordinates of a ray and a triangle in double precision.
+
+The triangle is known to be hit, so that the coordinates are computed without any test.
+\param p Vertices of the triangle.
+\param o, d Origin and direction of the ray.
+\param t Intersection depth.
+\param u, v Parametric coordinates of the intersection.
+*/
+static inline void MeshBVHRefine(const Vector* p, const Vector& o, const Vector& d, double& t, double& u, double& v)
+{
+  const Vector e0 = p[1] - p[0];
+  const Vector e1 = p[2] - p[0];
+  const Vector pv = d / e1;
+  const double det = e0 * pv;
+  if (det == 0.0)
+    return;
+  const double inv = 1.0 / det;
+  const Vector tv = o - p[0];
+  const Vector qv = tv / e0;
+  u = (tv * pv) * inv;
+  v = (d * qv) * inv;
+  t = (e1 * qv) * inv;
+}
+
+/*!
+\brief Compute the closest intersection between a ray and the triangles.
+
+Children are visited front to back, and nodes whose entry distance exceeds the closest
+intersection found so far are skipped. Leaves are intersected in single precision, see
+TriangleBlockF::Intersect(), and the closest intersection is recomputed in double precision.
+\param ray The ray.
+\param t Intersection depth.
+\param u, v Parametric coordinates of the intersection in the triangle.
+\param i Index of the intersected triangle in the mesh.
+\param tmax Maximum distance.
+*/
+bool MeshBVH::Intersect(const Ray& ray, double& t, double& u, double& v, int& i, double tmax) const
+{
+  if (nodes.empty())
+    return false;
+
+  // Boxes are tested against the same ray as the triangles
+  const RayF r(ray);
+  const Vector o = MeshBVHRound(ray.Origin());
+  const Vector inv = MeshBVHRound(ray.Direction()).Inverse();
+
+  double t0 = 0.0, t1 = tmax;
+  if (!nodes[0].box.Intersect(o, inv, t0, t1))
+    return false;
+
+  // Stack of nodes with their entry distance
+  int stack[2 * MaxDepth];
+  double entry[2 * MaxDepth];
+  int size = 0;
+
+  int hit = -1;
+  int k = 0;
+  while (true)
+  {
+    const MeshBVHNode& node = nodes[k];
+    if (node.count != 0)
+    {
+      const TriangleBlockF& block = blocks[node.block];
+      float tt, uu, vv;
+      const int l = block.Intersect(r, float(tmax), tt, uu, vv, watertight);
+      if (l != -1)
+      {
+        tmax = t = tt;
+        u = uu;
+        v = vv;
+        hit = block.Index(l);
+      }
+    }
+    else
+    {
+      int l = k + 1, r = node.index;
+      double tl = 0.0, tr = 0.0, sl = tmax, sr = tmax;
+      if (!nodes[l].box.Intersect(o, inv, tl, sl))
+      {
+        tl = Math::Infinity;
+      }
+      if (!nodes[r].box.Intersect(o, inv, tr, sr))
+      {
+        tr = Math::Infinity;
+      }
+      if (tr < tl)
+      {
+        std::swap(l, r);
+        std::swap(tl, tr);
+      }
+      if (tl != Math::Infinity)
+      {
+        if (tr != Math::Infinity)
+        {
+          stack[size] = r;
+          entry[size] = tr;
+          size++;
+        }
+        k = l;
+        continue;
+      }
+    }
+
+    // Next node that may still be closer than the closest intersection
+    while (size > 0 && entry[size - 1] >= tmax)
+    {
+      size--;
+    }
+    if (size == 0)
+      break;
+    size--;
+    k = stack[size];
+  }
+
+  if (hit == -1)
+    return false;
+  MeshBVHRefine(&vertices[3 * size_t(hit)], ray.Origin(), ray.Direction(), t, u, v);
+  i = index[hit];
+  return true;
+}
+
+/*!
+\brief Check if a ray intersects any triangle, which stops at the first intersection found.
+\param ray The ray.
+\param tmax Maximum distance.
+*/
+bool MeshBVH::Occluded(const Ray& ray, double tmax) const
+{
+  if (nodes.empty())
+    return false;
+
+  // Boxes are tested against the same ray as the triangles
+  const RayF r(ray);
+  const Vector o = MeshBVHRound(ray.Origin());
+  const Vector inv = MeshBVHRound(ray.Direction()).Inverse();
+
+  double t0 = 0.0, t1 = tmax;
+  if (!nodes[0].box.Intersect(o, inv, t0, t1))
+    return false;
+
+  int stack[2 * MaxDepth];
+  int size = 0;
+  int k = 0;
+  while (true)
+  {
+    const MeshBVHNode& node = nodes[k];
+    if (node.count != 0)
+    {
+      float t, u, v;
+      if (blocks[node.block].Intersect(r, float(tmax), t, u, v, watertight) != -1)
+        return true;
+    }
+    else
+    {
+      const int l = k + 1, r = node.index;
+      double tl = 0.0, tr = 0.0, sl = tmax, sr = tmax;
+      const bool hl = nodes[l].box.Intersect(o, inv, tl, sl);
+      const bool hr = nodes[r].box.Intersect(o, inv, tr, sr);
+      if (hl || hr)
+      {
+        if (hl && hr)
+        {
+          stack[size++] = r;
+        }
+        k = hl ? l : r;
+        continue;
+      }
+    }
+    if (size == 0)
+      break;
+    k = stack[--size];
+  }
+  return false;
+}
+
+/*!
+\brief Find the closest point of the triangles to a point.
+
+The traversal descends into the closest child of every node and keeps the other one in a priority
+queue ordered by the distance to the boxes. When a leaf is reached, the closest queued node is visited
+next, and the traversal stops as soon as it is farther than the closest triangle found so far.
+\param p The point.
+\param q Returned closest point.
+\param u, v Returned parametric coordinates of the closest point in the triangle, see Triangle::Vertex().
+\param i Returned index of the triangle in the mesh, -1 if none.
+\param dmax Maximum distance.
+\return The distance, infinite if no triangle is closer than the maximum distance.
+*/
+double MeshBVH::Closest(const Vector& p, Vector& q, double& u, double& v, int& i, double dmax) const
+{
+  i = -1;
+  if (nodes.empty())
+    return Math::Infinity;
+
+  // Squared distances
+  double d = dmax * dmax;
+  typedef std::pair<double, int> Entry;
+  std::vector<Entry> heap;
+  heap.reserve(2 * MaxDepth);
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue(std::greater<Entry>(), std::move(heap));
+
+  int k = nodes[0].box.R(p) < d ? 0 : -1;
+  while (k != -1)
+  {
+    const MeshBVHNode& node = nodes[k];
+    k = -1;
+    if (node.IsLeaf())
+    {
+      for (int j = node.index; j < node.index + node.count; j++)
+      {
+        const Vector* t = &vertices[3 * size_t(j)];
+        double a, b;
+        const Vector c = Triangle(t[0], t[1], t[2]).Closest(p, a, b);
+        const double e = SquaredNorm(p - c);
+        if (e < d)
+        {
+          d = e;
+          q = c;
+          u = a;
+          v = b;
+          i = index[j];
+        }
+      }
+    }
+    else
+    {
+      // Descend into the closest child and queue the other one
+      int a = int(&node - nodes.data()) + 1;
+      int b = node.index;
+      double ra = nodes[a].box.R(p);
+      double rb = nodes[b].box.R(p);
+      if (rb < ra)
+      {
+        std::swap(a, b);
+        std::swap(ra, rb);
+      }
+      if (ra < d)
+      {
+        k = a;
+        if (rb < d)
+          queue.push(Entry(rb, b));
+      }
+    }
+
+    // Closest queued node, the traversal stops when it is farther than the closest triangle
+    if (k == -1 && !queue.empty() && queue.top().first < d)
+    {
+      k = queue.top().second;
+      queue.pop();
+    }
+  }
+  return i == -1 ? Math::Infinity : sqrt(d);
+}
+
+/*!
+\brief Check if a box is missed by all the rays of a packet, given the intervals of their origins and inverse directions.
+
+Distances to the planes of the box are bounded with interval arithmetic along every axis, which
+requires the inverse directions of the rays to have the same sign along every axis.
+\param box The box.
+\param oa, ob Intervals of the origins.
+\param ia, ib Intervals of the inverse directions.
+\param tmax Largest maximum distance of the rays.
+*/
+static inline bool MeshBVHCull(const Box& box, const Vector& oa, const Vector& ob, const Vector& ia, const Vector& ib, double tmax)
+{
+  double tmin = 0.0;
+  for (int k = 0; k < 3; k++)
+  {
+    double tn, tf;
+    if (ia[k] >= 0.0)
+    {
+      // Lower bound of (a-o)i and upper bound of (b-o)i for positive inverse directions
+      const double x = box[0][k] - ob[k];
+      const double y = box[1][k] - oa[k];
+      tn = x >= 0.0 ? x * ia[k] : x * ib[k];
+      tf = y >= 0.0 ? y * ib[k] : y * ia[k];
+    }
+    else
+    {
+      const double x = box[1][k] - oa[k];
+      const double y = box[0][k] - ob[k];
+      tn = x >= 0.0 ? x * ia[k] : x * ib[k];
+      tf = y >= 0.0 ? y * ib[k] : y * ia[k];
+    }
+    // Undefined bounds, from null directions, never cull
+    tmin = tn > tmin ? tn : tmin;
+    tmax = tf < tmax ? tf : tmax;
+  }
+  return tmin > tmax;
+}
+
+#if defined(__AVX__)
+/*!
+\brief Intersect eight rays of a packet with the triangles of a block with the Moller-Trumbore algorithm, one triangle at a time.
+
+This is the transpose of TriangleBlockF::Intersect(), with the same arithmetic, and keeps the closest
+intersection of every ray in registers.
+\param block The block.
+\param ray Origins and directions of the eight rays, stored by coordinate, with a stride of MeshBVH::PacketSize.
+\param active Mask of the rays to test.
+\param t Maximum distances of the rays, updated with the depth of the closest intersections.
+\param u, v Parametric coordinates of the closest intersections.
+\param lane Lanes of the closest triangles, unchanged for the rays that miss the triangles.
+*/
+static void MeshBVHIntersect(const TriangleBlockF& block, const float* ray, int active, float* t, float* u, float* v, int* lane)
+{
+  const int s = MeshBVH::PacketSize;
+  const __m256 ox = _mm256_load_ps(ray), oy = _mm256_load_ps(ray + s), oz = _mm256_load_ps(ray + 2 * s);
+  const __m256 dx = _mm256_load_ps(ray + 3 * s), dy = _mm256_load_ps(ray + 4 * s), dz = _mm256_load_ps(ray + 5 * s);
+  const __m256 mask = _mm256_castsi256_ps(_mm256_set_epi32(-(active >> 7 & 1), -(active >> 6 & 1), -(active >> 5 & 1), -(active >> 4 & 1), -(active >> 3 & 1), -(active >> 2 & 1), -(active >> 1 & 1), -(active & 1)));
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  __m256 tb = _mm256_load_ps(t), ub = _mm256_load_ps(u), vb = _mm256_load_ps(v);
+  __m256 lb = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  for (int l = 0; l < block.Size(); l++)
+  {
+    const float px = block.Coordinates(0, 0)[l], py = block.Coordinates(0, 1)[l], pz = block.Coordinates(0, 2)[l];
+    const __m256 e1x = _mm256_set1_ps(block.Coordinates(1, 0)[l] - px);
+    const __m256 e1y = _mm256_set1_ps(block.Coordinates(1, 1)[l] - py);
+    const __m256 e1z = _mm256_set1_ps(block.Coordinates(1, 2)[l] - pz);
+    const __m256 e2x = _mm256_set1_ps(block.Coordinates(2, 0)[l] - px);
+    const __m256 e2y = _mm256_set1_ps(block.Coordinates(2, 1)[l] - py);
+    const __m256 e2z = _mm256_set1_ps(block.Coordinates(2, 2)[l] - pz);
+
+    const __m256 sx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    const __m256 sy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    const __m256 sz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, sx), _mm256_mul_ps(e1y, sy)), _mm256_mul_ps(e1z, sz));
+    const __m256 inv = _mm256_div_ps(one, det);
+
+    const __m256 tx = _mm256_sub_ps(ox, _mm256_set1_ps(px));
+    const __m256 ty = _mm256_sub_ps(oy, _mm256_set1_ps(py));
+    const __m256 tz = _mm256_sub_ps(oz, _mm256_set1_ps(pz));
+    const __m256 a = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, sx), _mm256_mul_ps(ty, sy)), _mm256_mul_ps(tz, sz)), inv);
+
+    const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+    const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+    const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+    const __m256 b = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv);
+    const __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv);
+
+    __m256 hit = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GE_OQ), _mm256_cmp_ps(b, zero, _CMP_GE_OQ)));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(a, b), one, _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GT_OQ), _mm256_cmp_ps(d, tb, _CMP_LT_OQ)));
+    tb = _mm256_blendv_ps(tb, d, hit);
+    ub = _mm256_blendv_ps(ub, a, hit);
+    vb = _mm256_blendv_ps(vb, b, hit);
+    lb = _mm256_blendv_ps(lb, _mm256_castsi256_ps(_mm256_set1_epi32(l)), hit);
+  }
+  _mm256_store_ps(t, tb);
+  _mm256_store_ps(u, ub);
+  _mm256_store_ps(v, vb);
+  _mm256_storeu_si256((__m256i*)lane, _mm256_castps_si256(lb));
+}
+#endif
+
+/*!
+\brief Compute the closest intersections of a packet of rays.
+
+The rays are traversed together, so that every node is fetched once for the whole packet, which
+is efficient for coherent rays such as the camera rays of a tile of pixels. Nodes are culled for
+the whole packet with interval arithmetic, and the packet keeps track of its first active ray
+[Wald et al. 2007]: rays before it missed the box of the node and are skipped in the subtree.
+Children are visited front to back along the split axis of the node.
+
+Leaves are intersected with groups of eight rays one triangle at a time in the default mode,
+and ray after ray in watertight mode. Rays whose directions do not share the same signs are
+traced one at a time.
+
+Packets larger than PacketSize are split.
+\param rays Array of rays.
+\param n Number of rays.
+\param hits Closest intersections, indexed like the rays.
+\param tmax Maximum distance.
+\return The number of rays intersecting the mesh.
+*/
+int MeshBVH::Intersect(const Ray* rays, int n, MeshBVHHit* hits, double tmax) const
+{
+  if (n > PacketSize)
+  {
+    int c = 0;
+    for (int j = 0; j < n; j += PacketSize)
+    {
+      c += Intersect(rays + j, n - j < PacketSize ? n - j : PacketSize, hits + j, tmax);
+    }
+    return c;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    hits[i] = MeshBVHHit();
+  }
+  if (nodes.empty() || n <= 0)
+    return 0;
+
+  // Boxes are tested against the same rays as the triangles
+  RayF r[PacketSize];
+  Vector o[PacketSize], inv[PacketSize];
+  double far[PacketSize];
+  int hit[PacketSize];
+  for (int i = 0; i < n; i++)
+  {
+    r[i] = RayF(rays[i]);
+    o[i] = MeshBVHRound(rays[i].Origin());
+    inv[i] = MeshBVHRound(rays[i].Direction()).Inverse();
+    far[i] = tmax;
+    hit[i] = -1;
+  }
+#if defined(__AVX__)
+  // Origins and directions in structure of arrays layout for the kernel of eight rays
+  alignas(32) float packet[6][PacketSize] = {};
+  for (int i = 0; i < n; i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      packet[k][i] = float(rays[i].Origin()[k]);
+      packet[3 + k][i] = float(rays[i].Direction()[k]);
+    }
+  }
+#endif
+  for (int i = n; i < PacketSize; i++)
+  {
+    far[i] = tmax;
+  }
+
+  // Intervals of the packet
+  Vector oa = o[0], ob = o[0], ia = inv[0], ib = inv[0];
+  for (int i = 1; i < n; i++)
+  {
+    oa = Vector::Min(oa, o[i]);
+    ob = Vector::Max(ob, o[i]);
+    ia = Vector::Min(ia, inv[i]);
+    ib = Vector::Max(ib, inv[i]);
+  }
+  bool frustum = true;
+  for (int k = 0; k < 3; k++)
+  {
+    frustum = frustum && (ia[k] >= 0.0 || ib[k] < 0.0);
+  }
+
+  // Incoherent rays are traced one at a time
+  if (!frustum)
+  {
+    int c = 0;
+    for (int i = 0; i < n; i++)
+    {
+      if (Intersect(rays[i], hits[i].t, hits[i].u, hits[i].v, hits[i].index, tmax))
+      {
+        c++;
+      }
+      else
+      {
+        hits[i] = MeshBVHHit();
+      }
+    }
+    return c;
+  }
+  double fmax = tmax;
+
+  // Stack of nodes with the first active ray of the packet
+  int stack[2 * MaxDepth];
+  int first[2 * MaxDepth];
+  int size = 0;
+
+  int k = 0, f = 0;
+  while (true)
+  {
+    const MeshBVHNode& node = nodes[k];
+    bool visit = !MeshBVHCull(node.box, oa, ob, ia, ib, fmax);
+    if (visit)
+    {
+      for (; f < n; f++)
+      {
+        double t0 = 0.0, t1 = far[f];
+        if (node.box.Intersect(o[f], inv[f], t0, t1))
+          break;
+      }
+      visit = f < n;
+    }
+    if (visit)
+    {
+      if (node.count != 0)
+      {
+        const TriangleBlockF& block = blocks[node.block];
+#if defined(__AVX__)
+        if (!watertight)
+        {
+          // Groups of eight rays
+          for (int g = f - f % 8; g < n; g += 8)
+          {
+            int active = 0;
+            for (int i = g > f ? g : f; i < g + 8 && i < n; i++)
+            {
+              double t0 = 0.0, t1 = far[i];
+              if (i == f || node.box.Intersect(o[i], inv[i], t0, t1))
+              {
+                active |= 1 << (i - g);
+              }
+            }
+            if (active == 0)
+              continue;
+            alignas(32) float tt[8], uu[8], vv[8];
+            int lane[8];
+            for (int j = 0; j < 8; j++)
+            {
+              tt[j] = float(far[g + j]);
+              uu[j] = vv[j] = 0.0f;
+            }
+            MeshBVHIntersect(block, &packet[0][g], active, tt, uu, vv, lane);
+            for (int j = 0; j < 8; j++)
+            {
+              if (lane[j] != -1)
+              {
+                far[g + j] = tt[j];
+                hits[g + j].u = uu[j];
+                hits[g + j].v = vv[j];
+                hit[g + j] = block.Index(lane[j]);
+              }
+            }
+          }
+        }
+        else
+#endif
+        {
+          for (int i = f; i < n; i++)
+          {
+            double t0 = 0.0, t1 = far[i];
+            if (i != f && !node.box.Intersect(o[i], inv[i], t0, t1))
+              continue;
+            float tt, uu, vv;
+            const int l = block.Intersect(r[i], float(far[i]), tt, uu, vv, watertight);
+            if (l != -1)
+            {
+              far[i] = tt;
+              hits[i].u = uu;
+              hits[i].v = vv;
+              hit[i] = block.Index(l);
+            }
+          }
+        }
+        fmax = far[0];
+        for (int i = 1; i < n; i++)
+        {
+          fmax = far[i] > fmax ? far[i] : fmax;
+        }
+      }
+      else
+      {
+        int l = k + 1, r = node.index;
+        if (inv[f][node.axis] < 0.0)
+        {
+          std::swap(l, r);
+        }
+        stack[size] = r;
+        first[size] = f;
+        size++;
+        k = l;
+        continue;
+      }
+    }
+    if (size == 0)
+      break;
+    size--;
+    k = stack[size];
+    f = first[size];
+  }
+
+  int c = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (hit[i] != -1)
+    {
+      hits[i].t = far[i];
+      MeshBVHRefine(&vertices[3 * size_t(hit[i])], rays[i].Origin(), rays[i].Direction(), hits[i].t, hits[i].u, hits[i].v);
+      hits[i].index = index[hit[i]];
+      c++;
+    }
+  }
+  return c;
+}
+
+/*!
+\brief Compute the closest intersections of a stream of rays.
+
+The stream is split into packets of PacketSize consecutive rays that are traced in parallel,
+so that coherent rays should be consecutive, for instance the camera rays of tiles of 8&times;8
+pixels rather than scanlines.
+\param rays Array of rays.
+\param hits Closest intersections, indexed like the rays.
+\param tmax Maximum distance.
+*/
+void MeshBVH::Intersect(const std::vector<Ray>& rays, std::vector<MeshBVHHit>& hits, double tmax) const
+{
+  const int n = int(rays.size());
+  hits.resize(n);
+  const int packets = (n + PacketSize - 1) / PacketSize;
+#pragma omp parallel for schedule(dynamic) if(n >= Parallel::Grain / 16)
+  for (int j = 0; j < packets; j++)
+  {
+    const int first = j * PacketSize;
+    Intersect(&rays[first], n - first < PacketSize ? n - first : PacketSize, &hits[first], tmax);
+  }
+}
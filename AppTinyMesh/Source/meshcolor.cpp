@@ -1,4 +1,5 @@
 #include "meshcolor.h"
+#include "meshbvh.h"
 
 /*!
 \brief Create an empty mesh.
@@ -27,9 +28,260 @@ MeshColor::MeshColor(const Mesh& m) : Mesh(m)
 	carray = varray;
 }
 
+/*!
+\brief Constructor from a Mesh, taking ownership of its arrays.
+\param m the base mesh
+*/
+MeshColor::MeshColor(Mesh&& m) : Mesh(std::move(m))
+{
+	colors.resize(vertices.size(), Color(1.0, 1.0, 1.0));
+	carray = varray;
+}
+
+/*!
+\brief Constructor from a Mesh with color array and indices, taking ownership of the arrays.
+\param m Base mesh.
+\param cols Color array.
+\param carr Color indexes, should be the same size as Mesh::varray and Mesh::narray.
+*/
+MeshColor::MeshColor(Mesh&& m, std::vector<Color>&& cols, std::vector<int>&& carr) : Mesh(std::move(m)), colors(std::move(cols)), carray(std::move(carr))
+{
+}
+
 /*!
 \brief Empty.
 */
 MeshColor::~MeshColor()
 {
 }
+
+/*!
+\brief Rebuild the mesh from a subset of its triangles and a renumbering of its vertices.
+
+Colors indexed like the vertices are renumbered along with the vertices, otherwise only
+their indexes are gathered with the triangles.
+\sa Mesh::Remap()
+*/
+void MeshColor::Remap(const std::vector<int>& triangles, const std::vector<int>& source, const std::vector<int>& vertexes)
+{
+  const int nt = int(triangles.size());
+
+  const bool vertexColors = (carray == varray) && (colors.size() == vertices.size());
+
+  if (vertexColors)
+  {
+    const int nv = int(source.size());
+    std::vector<Color> c(nv);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      c[i] = colors[source[i]];
+    }
+    colors.swap(c);
+  }
+  else if (!carray.empty())
+  {
+    std::vector<int> ca(nt * 3);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nt; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        ca[i * 3 + j] = carray[triangles[i] * 3 + j];
+      }
+    }
+    carray.swap(ca);
+  }
+
+  Mesh::Remap(triangles, source, vertexes);
+
+  if (vertexColors)
+  {
+    carray = varray;
+  }
+}
+
+/*!
+\brief Get the attributes interpolated along with the vertices, including the colors.
+
+Colors indexed per triangle corner, such as colors per face, are averaged at the vertices,
+so that they follow the vertices created or merged by processing functions.
+\param attributes Returned attributes, stored per vertex.
+\return The number of attributes per vertex.
+*/
+int MeshColor::VertexAttributes(std::vector<double>& attributes) const
+{
+  const int m = Mesh::VertexAttributes(attributes);
+  if (carray.size() != varray.size() || colors.empty())
+    return m;
+
+  const int nv = Vertexes();
+
+  // Colors of the vertices, averaged over the corners if they are not indexed like the vertices
+  std::vector<Color> vc;
+  const bool vertexColors = (carray == varray) && (colors.size() == vertices.size());
+  if (!vertexColors)
+  {
+    vc.assign(nv, Color(0.0, 0.0, 0.0, 0.0));
+    std::vector<int> count(nv, 0);
+    for (int i = 0; i < int(varray.size()); i++)
+    {
+      vc[varray[i]] += colors[carray[i]];
+      count[varray[i]]++;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nv; i++)
+    {
+      vc[i] = count[i] > 0 ? vc[i] / double(count[i]) : Color(1.0, 1.0, 1.0);
+    }
+  }
+  const std::vector<Color>& c = vertexColors ? colors : vc;
+
+  const int n = m + 4;
+  std::vector<double> a(nv * n);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    for (int j = 0; j < m; j++)
+    {
+      a[i * n + j] = attributes[i * m + j];
+    }
+    for (int j = 0; j < 4; j++)
+    {
+      a[i * n + m + j] = c[i][j];
+    }
+  }
+  attributes.swap(a);
+  return n;
+}
+
+/*!
+\brief Set the attributes of the vertices, the inverse of MeshColor::VertexAttributes().
+
+Colors are clamped. If the attributes include colors, they become indexed like the vertices,
+which lets processing functions that create vertices, such as Mesh::Subdivide(), carry colors over.
+Otherwise, colors whose indexes no longer match the triangles are reset to white vertex colors.
+\param attributes Attributes, stored per vertex.
+\param n Number of attributes per vertex, colors come last.
+*/
+void MeshColor::SetVertexAttributes(const std::vector<double>& attributes, int n)
+{
+  Mesh::SetVertexAttributes(attributes, n);
+
+  const int nv = Vertexes();
+
+  // Colors follow the attributes of the mesh
+  const int m = (narray == varray && normals.size() == vertices.size()) ? 3 : 0;
+  if (n != m + 4)
+  {
+    if (carray.size() != varray.size())
+    {
+      colors.assign(nv, Color(1.0, 1.0, 1.0));
+      carray = varray;
+    }
+    return;
+  }
+
+  colors.resize(nv);
+  carray = varray;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    const double* c = &attributes[i * n + n - 4];
+    colors[i] = Color(Math::Clamp(c[0]), Math::Clamp(c[1]), Math::Clamp(c[2]), Math::Clamp(c[3]));
+  }
+}
+
+/*!
+\brief Draw a uniform random number in [0,1) from a SplitMix64 stream [Steele et al. 2014].
+
+The state is a counter advanced by a constant, and every output is a hash of the counter,
+so streams seeded with different values are cheap to create and independent.
+\param state State of the stream.
+*/
+static inline double MeshColorRandom(unsigned long long& state)
+{
+  unsigned long long z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+
+  // Upper 53 bits, exactly represented in double precision
+  return double(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*!
+\brief Bake the ambient occlusion of the mesh into the colors, which become indexed like the vertices.
+
+Every vertex shoots rays over the hemisphere around its normal with a cosine weighted distribution,
+so that the fraction of unoccluded rays is the ambient light received by a diffuse surface. The
+hemisphere is stratified into a grid of k&times;k cells with one jittered ray per cell, the number of
+samples being rounded to the closest square. Rays are traced against a MeshBVH of the mesh.
+
+Vertices are processed in parallel. Every vertex draws from its own random stream, seeded from
+the seed and the index of the vertex, so that the result does not depend on the number of threads.
+\code
+MeshColor mesh(sphere);
+mesh.AmbientOcclusion(64, 0.5); // Occlusion by the triangles closer than 0.5
+\endcode
+\param samples Number of rays per vertex.
+\param distance Maximum distance of the occluders.
+\param seed Seed of the random streams of the vertices.
+*/
+void MeshColor::AmbientOcclusion(int samples, double distance, unsigned int seed)
+{
+  const int nv = Vertexes();
+  const int k = samples < 1 ? 1 : int(sqrt(double(samples)) + 0.5);
+
+  // Vertex normals, smoothed if they are not indexed like the vertices
+  Mesh smooth;
+  const std::vector<Vector>* vn = &normals;
+  if (narray != varray || normals.size() != vertices.size())
+  {
+    smooth = Mesh(vertices, varray);
+    smooth.SmoothNormals();
+    vn = &smooth.Normals();
+  }
+
+  const MeshBVH bvh(*this);
+
+  // Offset of the origins of the rays along the normals, which avoids self intersections
+  const double epsilon = 1e-5 * Norm(bvh.GetBox().Diagonal());
+
+  colors.resize(nv);
+  carray = varray;
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    const Vector n = (*vn)[i];
+    if (n == Vector::Null)
+    {
+      colors[i] = Color(1.0, 1.0, 1.0);
+      continue;
+    }
+    Vector x, y;
+    n.Orthonormal(x, y);
+    const Vector p = vertices[i] + epsilon * n;
+
+    unsigned long long state = (unsigned long long)(seed) << 32 | unsigned(i);
+
+    int visible = 0;
+    for (int a = 0; a < k; a++)
+    {
+      for (int b = 0; b < k; b++)
+      {
+        // Jittered sample in the cell, mapped to the unit disc and projected on the hemisphere
+        const double u = (a + MeshColorRandom(state)) / k;
+        const double v = (b + MeshColorRandom(state)) / k;
+        const double r = sqrt(u);
+        const double phi = 2.0 * 3.14159265358979323846 * v;
+        const Vector d = r * cos(phi) * x + r * sin(phi) * y + sqrt(1.0 - u) * n;
+        if (!bvh.Occluded(Ray(p, d), distance))
+          visible++;
+      }
+    }
+    const double ao = double(visible) / (k * k);
+    colors[i] = Color(ao, ao, ao);
+  }
+}
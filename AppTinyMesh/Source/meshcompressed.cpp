@@ -0,0 +1,405 @@
+// Compressed mesh
+
+#include "meshcompressed.h"
+#include "parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESH_COMPRESSED_SSE2
+#endif
+
+/*!
+\class MeshCompressed meshcompressed.h
+\brief Quantized and compressed triangle mesh, with random access.
+
+Vertices are quantized on 16 bits per axis relative to the box of the mesh, and normals are
+encoded as two 16 bits coordinates of the octahedral projection [Meyer et al. 2010], which
+takes 10 bytes per vertex instead of 48 for the double precision arrays of Mesh. Both are
+stored as separate arrays per coordinate, so that they are decoded with SIMD instructions.
+
+Triangle indexes are split into blocks of MeshCompressed::BlockSize triangles. In every block,
+every index is stored as the difference with the previous one, zigzag mapped to an unsigned
+integer and written with a variable number of bytes, seven bits per byte. Normal indexes are
+only stored if they differ from the vertex indexes, and meshes without normal indexes are decoded
+without them. Blocks are decoded independently, lazily
+when a triangle is accessed, or in parallel when the whole mesh is decoded.
+
+The precision loss is bounded by half the quantization step, i.e. the size of the box divided
+by 131070 along every axis, and about 10<sup>-4</sup> radian for normals.
+\code
+MeshCompressed compressed(mesh); // Compressed copy
+Triangle t = compressed.GetTriangle(i); // Decodes part of a block
+Mesh decoded = compressed.ToMesh(); // Decodes everything
+\endcode
+*/
+
+/*!
+\brief Encode the indexes of a block of triangles.
+\param index First index.
+\param n Number of indexes.
+\param stream Output stream.
+*/
+static void EncodeIndexes(const int* index, int n, std::vector<unsigned char>& stream)
+{
+  int previous = 0;
+  for (int i = 0; i < n; i++)
+  {
+    const int d = index[i] - previous;
+    previous = index[i];
+
+    // Zigzag mapping of the difference, small negative and positive values become small integers
+    unsigned int u = (unsigned int)(d) << 1 ^ (unsigned int)(d >> 31);
+    while (u >= 0x80)
+    {
+      stream.push_back((unsigned char)(u | 0x80));
+      u >>= 7;
+    }
+    stream.push_back((unsigned char)(u));
+  }
+}
+
+/*!
+\brief Decode indexes from a block.
+\param data Encoded block.
+\param n Number of indexes to decode.
+\param index Output indexes, may be null to decode only the last one.
+\return The last decoded index.
+*/
+static int DecodeIndexes(const unsigned char* data, int n, int* index)
+{
+  int previous = 0;
+  for (int i = 0; i < n; i++)
+  {
+    unsigned int u = 0;
+    int shift = 0;
+    unsigned char c;
+    do
+    {
+      c = *data++;
+      u |= (unsigned int)(c & 0x7f) << shift;
+      shift += 7;
+    } while (c & 0x80);
+
+    previous += int(u >> 1) ^ -int(u & 1);
+    if (index)
+    {
+      index[i] = previous;
+    }
+  }
+  return previous;
+}
+
+/*!
+\brief Encode blocks of indexes in parallel.
+\param indexes Indexes.
+\param stream Output stream.
+\param offset Output offsets of the blocks, with an extra one for the end of the stream.
+*/
+static void EncodeBlocks(const std::vector<int>& indexes, std::vector<unsigned char>& stream, std::vector<unsigned int>& offset)
+{
+  const int n = int(indexes.size());
+  const int size = 3 * MeshCompressed::BlockSize;
+  const int nb = (n + size - 1) / size;
+
+  std::vector<std::vector<unsigned char>> blocks(nb);
+  offset.resize(nb + 1);
+
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int b = 0; b < nb; b++)
+  {
+    const int first = b * size;
+    const int count = (first + size < n) ? size : n - first;
+    blocks[b].reserve(count * 2);
+    EncodeIndexes(&indexes[first], count, blocks[b]);
+    offset[b] = (unsigned int)(blocks[b].size());
+  }
+  offset[nb] = 0;
+  Parallel::ExclusiveScan(offset);
+
+  stream.resize(offset[nb]);
+#pragma omp parallel for schedule(static)
+  for (int b = 0; b < nb; b++)
+  {
+    std::copy(blocks[b].begin(), blocks[b].end(), stream.begin() + offset[b]);
+  }
+}
+
+/*!
+\brief Compress a mesh.
+\param mesh The mesh.
+*/
+MeshCompressed::MeshCompressed(const Mesh& mesh) :box(mesh.GetBox()), triangles(mesh.Triangles())
+{
+  const std::vector<Vector>& vertices = mesh.Vertices();
+  const std::vector<Vector>& normals = mesh.Normals();
+  const int nv = int(vertices.size());
+  const int nn = int(normals.size());
+
+  // Quantization
+  const Vector diagonal = box.Diagonal();
+  Vector scale;
+  for (int j = 0; j < 3; j++)
+  {
+    step[j] = diagonal[j] / 65535.0;
+    scale[j] = diagonal[j] > 0.0 ? 65535.0 / diagonal[j] : 0.0;
+  }
+
+  px.resize(nv);
+  py.resize(nv);
+  pz.resize(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    const Vector p = (vertices[i] - box[0]).Scaled(scale);
+    px[i] = (unsigned short)(Math::Clamp(p[0] + 0.5, 0.0, 65535.0));
+    py[i] = (unsigned short)(Math::Clamp(p[1] + 0.5, 0.0, 65535.0));
+    pz[i] = (unsigned short)(Math::Clamp(p[2] + 0.5, 0.0, 65535.0));
+  }
+
+  // Octahedral normals, the lower hemisphere is folded over the diagonals
+  ou.resize(nn);
+  ov.resize(nn);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nn; i++)
+  {
+    const Vector n = normals[i];
+    const double l = fabs(n[0]) + fabs(n[1]) + fabs(n[2]);
+    double u = l > 0.0 ? n[0] / l : 0.0;
+    double v = l > 0.0 ? n[1] / l : 0.0;
+    if (n[2] < 0.0)
+    {
+      const double a = (1.0 - fabs(v)) * (u >= 0.0 ? 1.0 : -1.0);
+      const double b = (1.0 - fabs(u)) * (v >= 0.0 ? 1.0 : -1.0);
+      u = a;
+      v = b;
+    }
+    ou[i] = short(floor(Math::Clamp(u, -1.0, 1.0) * 32767.0 + 0.5));
+    ov[i] = short(floor(Math::Clamp(v, -1.0, 1.0) * 32767.0 + 0.5));
+  }
+
+  // Indexes
+  EncodeBlocks(mesh.VertexIndexes(), vstream, voffset);
+  normalIndexes = !mesh.NormalIndexes().empty();
+  if (normalIndexes && mesh.NormalIndexes() != mesh.VertexIndexes())
+  {
+    EncodeBlocks(mesh.NormalIndexes(), nstream, noffset);
+  }
+}
+
+/*!
+\brief Get a normal.
+\param i Index.
+*/
+Vector MeshCompressed::Normal(int i) const
+{
+  Vector n;
+  DecodeNormals(i, 1, &n);
+  return n;
+}
+
+/*!
+\brief Get the vertex index of a given triangle.
+
+Only the beginning of the block of the triangle is decoded.
+\param t Triangle index.
+\param i Vertex index.
+*/
+int MeshCompressed::VertexIndex(int t, int i) const
+{
+  const int b = t / BlockSize;
+  return DecodeIndexes(&vstream[voffset[b]], (t - b * BlockSize) * 3 + i + 1, nullptr);
+}
+
+/*!
+\brief Get the normal index of a given triangle.
+\param t Triangle index.
+\param i Normal index.
+\return The normal index, -1 if the mesh has no normal indexes.
+*/
+int MeshCompressed::NormalIndex(int t, int i) const
+{
+  if (!normalIndexes)
+  {
+    return -1;
+  }
+  if (nstream.empty())
+  {
+    return VertexIndex(t, i);
+  }
+  const int b = t / BlockSize;
+  return DecodeIndexes(&nstream[noffset[b]], (t - b * BlockSize) * 3 + i + 1, nullptr);
+}
+
+/*!
+\brief Get a triangle.
+\param t Index.
+*/
+Triangle MeshCompressed::GetTriangle(int t) const
+{
+  const int b = t / BlockSize;
+  const int k = (t - b * BlockSize) * 3;
+  int index[3 * BlockSize];
+  DecodeIndexes(&vstream[voffset[b]], k + 3, index);
+  return Triangle(Vertex(index[k]), Vertex(index[k + 1]), Vertex(index[k + 2]));
+}
+
+/*!
+\brief Decode a block of triangles.
+\param b Block index.
+\param va, na Output vertex and normal indexes, with room for 3*MeshCompressed::BlockSize indexes, the latter may be null
+and is left unchanged if the mesh has no normal indexes.
+\return The number of triangles in the block.
+*/
+int MeshCompressed::DecodeBlock(int b, int* va, int* na) const
+{
+  const int n = (b + 1) * BlockSize < triangles ? BlockSize : triangles - b * BlockSize;
+  DecodeIndexes(&vstream[voffset[b]], n * 3, va);
+  if (na && normalIndexes)
+  {
+    if (nstream.empty())
+    {
+      std::copy(va, va + n * 3, na);
+    }
+    else
+    {
+      DecodeIndexes(&nstream[noffset[b]], n * 3, na);
+    }
+  }
+  return n;
+}
+
+/*!
+\brief Decode a range of vertices.
+
+Quantized coordinates are converted and scaled four at a time with SIMD instructions when available.
+\param first First vertex.
+\param n Number of vertices.
+\param p Output vertices.
+*/
+void MeshCompressed::DecodeVertices(int first, int n, Vector* p) const
+{
+  const Vector a = box[0];
+  int i = 0;
+#ifdef MESH_COMPRESSED_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128d s[3] = { _mm_set1_pd(step[0]), _mm_set1_pd(step[1]), _mm_set1_pd(step[2]) };
+  const unsigned short* q[3] = { &px[first], &py[first], &pz[first] };
+  for (; i + 4 <= n; i += 4)
+  {
+    // Offsets to the lower corner in double precision, the same as MeshCompressed::Vertex()
+    alignas(16) double d[3][4];
+    for (int j = 0; j < 3; j++)
+    {
+      const __m128i w = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(q[j] + i)), zero);
+      _mm_store_pd(d[j], _mm_mul_pd(_mm_cvtepi32_pd(w), s[j]));
+      _mm_store_pd(d[j] + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(w, 8)), s[j]));
+    }
+    for (int k = 0; k < 4; k++)
+    {
+      p[i + k] = Vector(a[0] + d[0][k], a[1] + d[1][k], a[2] + d[2][k]);
+    }
+  }
+#endif
+  for (; i < n; i++)
+  {
+    p[i] = Vertex(first + i);
+  }
+}
+
+/*!
+\brief Decode a range of normals.
+
+The octahedral projection is unfolded and normalized four normals at a time with SIMD instructions when available.
+\param first First normal.
+\param n Number of normals.
+\param normal Output normals.
+*/
+void MeshCompressed::DecodeNormals(int first, int n, Vector* normal) const
+{
+  int i = 0;
+#ifdef MESH_COMPRESSED_SSE2
+  const __m128 unit = _mm_set1_ps(1.0f / 32767.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4)
+  {
+    // Sign extension of the 16 bits coordinates
+    const __m128i iu = _mm_loadl_epi64((const __m128i*)(&ou[first + i]));
+    const __m128i iv = _mm_loadl_epi64((const __m128i*)(&ov[first + i]));
+    __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(iu, iu), 16)), unit);
+    __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(iv, iv), 16)), unit);
+    const __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, x)), _mm_andnot_ps(sign, y));
+
+    // Unfold the lower hemisphere: x -= copysign(max(-z, 0), x)
+    const __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+    x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(sign, x)));
+    y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(sign, y)));
+
+    const __m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    alignas(16) float d[3][4];
+    _mm_store_ps(d[0], _mm_div_ps(x, l));
+    _mm_store_ps(d[1], _mm_div_ps(y, l));
+    _mm_store_ps(d[2], _mm_div_ps(z, l));
+    for (int k = 0; k < 4; k++)
+    {
+      normal[i + k] = Vector(d[0][k], d[1][k], d[2][k]);
+    }
+  }
+#endif
+  for (; i < n; i++)
+  {
+    double x = ou[first + i] / 32767.0;
+    double y = ov[first + i] / 32767.0;
+    const double z = 1.0 - fabs(x) - fabs(y);
+    const double t = Math::Max(-z, 0.0);
+    x -= x >= 0.0 ? t : -t;
+    y -= y >= 0.0 ? t : -t;
+    normal[i] = Normalized(Vector(x, y, z));
+  }
+}
+
+/*!
+\brief Decode the mesh, vertices and blocks of indexes are decoded in parallel.
+*/
+Mesh MeshCompressed::ToMesh() const
+{
+  const int nv = Vertexes();
+  const int nn = int(ou.size());
+  const int nb = Blocks();
+  const int chunk = 1024;
+
+  std::vector<Vector> vertices(nv);
+  std::vector<Vector> normals(nn);
+  std::vector<int> va(triangles * 3);
+  std::vector<int> na(normalIndexes ? triangles * 3 : 0);
+
+#pragma omp parallel for schedule(static)
+  for (int c = 0; c < (nv + chunk - 1) / chunk; c++)
+  {
+    const int first = c * chunk;
+    DecodeVertices(first, Math::Min(chunk, nv - first), &vertices[first]);
+  }
+#pragma omp parallel for schedule(static)
+  for (int c = 0; c < (nn + chunk - 1) / chunk; c++)
+  {
+    const int first = c * chunk;
+    DecodeNormals(first, Math::Min(chunk, nn - first), &normals[first]);
+  }
+#pragma omp parallel for schedule(static)
+  for (int b = 0; b < nb; b++)
+  {
+    DecodeBlock(b, &va[b * BlockSize * 3], na.empty() ? nullptr : &na[b * BlockSize * 3]);
+  }
+
+  return Mesh(std::move(vertices), std::move(normals), std::move(va), std::move(na));
+}
+
+/*!
+\brief Compute the memory used by the arrays of the mesh, in bytes.
+*/
+size_t MeshCompressed::Memory() const
+{
+  return (px.capacity() + py.capacity() + pz.capacity()) * sizeof(unsigned short) + (ou.capacity() + ov.capacity()) * sizeof(short)
+    + vstream.capacity() + nstream.capacity() + (voffset.capacity() + noffset.capacity()) * sizeof(unsigned int);
+}
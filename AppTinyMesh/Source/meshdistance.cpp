@@ -0,0 +1,177 @@
+// Distance to a mesh
+
+#include "meshdistance.h"
+#include "topology.h"
+
+/*!
+\class MeshDistance meshdistance.h
+\brief Unsigned and signed distance from points to the triangles of a mesh.
+
+The closest point is found with a best first traversal of a MeshBVH of the triangles, see
+MeshBVH::Closest(). The sign is the sign of the dot product between the vector from the closest
+point to the query point and the pseudo-normal of the feature of the mesh that contains the
+closest point, see Bærentzen and Aanæs, <i>Signed distance computation using the angle weighted
+pseudonormal</i>, IEEE TVCG, 2005. Faces use their normal, edges the sum of the normals of their
+two triangles, and vertices the sum of the normals of their triangles weighted by the angles at
+the vertex.
+
+Triangles should be oriented counter-clockwise seen from the outside, as the triangles of the meshes
+created by AnalyticScalarField::Polygonize(), so that distances are negative inside and match the sign
+convention of the implicit surfaces. The sign is exact for closed manifold meshes, and reversed for
+meshes oriented the other way.
+\code
+MeshDistance distance(mesh);
+double d = distance.Signed(Vector(0.5, 0.0, 0.0)); // Negative inside
+\endcode
+*/
+
+/*!
+\brief Create the hierarchy and the pseudo-normals of a mesh.
+\param mesh The mesh, with triangles oriented counter-clockwise seen from the outside.
+*/
+MeshDistance::MeshDistance(const Mesh& mesh) : bvh(mesh), varray(mesh.VertexIndexes())
+{
+  const int nt = mesh.Triangles();
+  const int nv = mesh.Vertexes();
+
+  faces.resize(nt);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nt; i++)
+  {
+    const Vector n = mesh.GetTriangle(i).AreaNormal();
+    const double length = Norm(n);
+    faces[i] = length > 0.0 ? n / length : Vector::Null;
+  }
+
+  // Edges shared by two consistently oriented triangles average their normals
+  const MeshTopology& topology = mesh.Topology();
+  edges.resize(3 * size_t(nt));
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < 3 * nt; h++)
+  {
+    const int twin = topology.Twin(h);
+    edges[h] = faces[MeshTopology::Face(h)] + faces[MeshTopology::Face(twin >= 0 ? twin : h)];
+  }
+
+  // Vertices weight the normals of their triangles by the angles at the vertex
+  std::vector<int> offset;
+  std::vector<int> triangles;
+  mesh.VertexTriangles(offset, triangles);
+  vertices.resize(nv);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    Vector n = Vector::Null;
+    for (int j = offset[i]; j < offset[i + 1]; j++)
+    {
+      const int t = triangles[j];
+      const int c = varray[3 * t] == i ? 0 : (varray[3 * t + 1] == i ? 1 : 2);
+      const Vector p = mesh.Vertex(i);
+      const Vector a = mesh.Vertex(varray[3 * t + (c + 1) % 3]) - p;
+      const Vector b = mesh.Vertex(varray[3 * t + (c + 2) % 3]) - p;
+      const double s = Norm(a) * Norm(b);
+      if (s > 0.0)
+      {
+        n += acos(Math::Clamp((a * b) / s, -1.0, 1.0)) * faces[t];
+      }
+    }
+    vertices[i] = n;
+  }
+}
+
+/*!
+\brief Get the pseudo-normal of the feature of a triangle that contains a point.
+
+The point is on a vertex or an edge if some of its parametric coordinates are null.
+\param t Triangle.
+\param u, v Parametric coordinates of the point, see Triangle::Vertex().
+*/
+Vector MeshDistance::PseudoNormal(int t, double u, double v) const
+{
+  const double epsilon = 1e-12;
+  const bool a = 1.0 - u - v <= epsilon;
+  const bool b = u <= epsilon;
+  const bool c = v <= epsilon;
+
+  // Vertices
+  if (b && c)
+    return vertices[varray[3 * t]];
+  if (a && c)
+    return vertices[varray[3 * t + 1]];
+  if (a && b)
+    return vertices[varray[3 * t + 2]];
+
+  // Edges, half-edge 3t+i goes from vertex i to vertex i+1
+  if (c)
+    return edges[3 * t];
+  if (a)
+    return edges[3 * t + 1];
+  if (b)
+    return edges[3 * t + 2];
+  return faces[t];
+}
+
+/*!
+\brief Compute the distance between a point and the mesh.
+\param p Point.
+\param dmax Maximum distance.
+\return The distance, infinite beyond the maximum distance.
+*/
+double MeshDistance::Distance(const Vector& p, double dmax) const
+{
+  Vector q;
+  double u, v;
+  int t;
+  return bvh.Closest(p, q, u, v, t, dmax);
+}
+
+/*!
+\brief Compute the signed distance between a point and the mesh.
+\param p Point.
+\param dmax Maximum distance.
+\return The signed distance, negative inside, and infinite beyond the maximum distance.
+*/
+double MeshDistance::Signed(const Vector& p, double dmax) const
+{
+  Vector q;
+  double u, v;
+  int t;
+  const double d = bvh.Closest(p, q, u, v, t, dmax);
+  if (t == -1)
+    return d;
+  return (p - q) * PseudoNormal(t, u, v) < 0.0 ? -d : d;
+}
+
+/*!
+\brief Compute the distance between a set of points and the mesh in parallel.
+\param points Points.
+\param distances Returned distances, infinite beyond the maximum distance.
+\param dmax Maximum distance.
+*/
+void MeshDistance::Distance(const std::vector<Vector>& points, std::vector<double>& distances, double dmax) const
+{
+  const int n = int(points.size());
+  distances.resize(n);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; i++)
+  {
+    distances[i] = Distance(points[i], dmax);
+  }
+}
+
+/*!
+\brief Compute the signed distance between a set of points and the mesh in parallel.
+\param points Points.
+\param distances Returned signed distances, infinite beyond the maximum distance.
+\param dmax Maximum distance.
+*/
+void MeshDistance::Signed(const std::vector<Vector>& points, std::vector<double>& distances, double dmax) const
+{
+  const int n = int(points.size());
+  distances.resize(n);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; i++)
+  {
+    distances[i] = Signed(points[i], dmax);
+  }
+}
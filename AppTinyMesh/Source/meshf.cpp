@@ -0,0 +1,147 @@
+// Single precision mesh
+
+#include "meshf.h"
+
+/*!
+\class MeshF meshf.h
+\brief Triangle mesh with single precision storage.
+
+Positions and normals are stored as three floats and colors as four floats, which halves the
+memory footprint and the bandwidth of the geometry compared to Mesh and MeshColor, and matches
+the format uploaded to the graphics card. Indexes are the same as in the double precision meshes.
+
+Meshes are converted from and to the double precision types when a pipeline needs the precision:
+\code
+MeshF stored(mesh);         // Rounded to single precision
+Mesh mesh = stored.ToMesh(); // Back to double precision
+\endcode
+*/
+
+/*!
+\brief Convert a mesh to single precision.
+\param mesh Double precision mesh.
+*/
+MeshF::MeshF(const Mesh& mesh) :varray(mesh.VertexIndexes()), narray(mesh.NormalIndexes())
+{
+  const std::vector<Vector>& v = mesh.Vertices();
+  const std::vector<Vector>& n = mesh.Normals();
+  const int nv = int(v.size());
+  const int nn = int(n.size());
+
+  vertices.resize(nv);
+  normals.resize(nn);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    vertices[i] = VectorF(v[i]);
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nn; i++)
+  {
+    normals[i] = VectorF(n[i]);
+  }
+}
+
+/*!
+\brief Convert a colored mesh to single precision.
+\param mesh Double precision mesh.
+*/
+MeshF::MeshF(const MeshColor& mesh) :MeshF(static_cast<const Mesh&>(mesh))
+{
+  const std::vector<Color>& c = mesh.GetColors();
+  const int nc = int(c.size());
+
+  carray = mesh.ColorIndexes();
+  colors.resize(nc);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nc; i++)
+  {
+    colors[i] = ColorF(c[i]);
+  }
+}
+
+/*!
+\brief Compute the bounding box of the vertices.
+*/
+Box MeshF::GetBox() const
+{
+  if (vertices.size() == 0)
+  {
+    return Box::Null;
+  }
+
+  float a[3] = { vertices[0][0], vertices[0][1], vertices[0][2] };
+  float b[3] = { a[0], a[1], a[2] };
+  for (const VectorF& v : vertices)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      a[j] = v[j] < a[j] ? v[j] : a[j];
+      b[j] = v[j] > b[j] ? v[j] : b[j];
+    }
+  }
+  return Box(Vector(a[0], a[1], a[2]), Vector(b[0], b[1], b[2]));
+}
+
+/*!
+\brief Compute the memory used by the arrays of the mesh, in bytes.
+*/
+size_t MeshF::Memory() const
+{
+  return vertices.capacity() * sizeof(VectorF) + normals.capacity() * sizeof(VectorF) + colors.capacity() * sizeof(ColorF)
+    + (varray.capacity() + narray.capacity() + carray.capacity()) * sizeof(int);
+}
+
+/*!
+\brief Convert to a double precision mesh, colors are discarded.
+*/
+Mesh MeshF::ToMesh() const
+{
+  const int nv = int(vertices.size());
+  const int nn = int(normals.size());
+
+  std::vector<Vector> v(nv);
+  std::vector<Vector> n(nn);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    v[i] = vertices[i].ToVector();
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nn; i++)
+  {
+    n[i] = normals[i].ToVector();
+  }
+
+  std::vector<int> va = varray;
+  std::vector<int> na = narray;
+  return Mesh(std::move(v), std::move(n), std::move(va), std::move(na));
+}
+
+/*!
+\brief Convert to a double precision colored mesh.
+
+Meshes without colors are converted with white colors indexed like the vertices.
+*/
+MeshColor MeshF::ToMeshColor() const
+{
+  if (colors.empty())
+  {
+    return MeshColor(ToMesh());
+  }
+
+  const int nc = int(colors.size());
+  std::vector<Color> c(nc);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nc; i++)
+  {
+    c[i] = colors[i].ToColor();
+  }
+
+  std::vector<int> ca = carray;
+  return MeshColor(ToMesh(), std::move(c), std::move(ca));
+}
@@ -0,0 +1,173 @@
+// Mesh statistics
+
+#include "meshstatistics.h"
+#include "parallel.h"
+
+/*!
+\class MeshStatistics meshstatistics.h
+\brief Geometric and quality statistics of a triangle mesh.
+
+Surface area, enclosed volume, bounding box, edge length statistics and the histogram of the
+aspect ratios of the triangles are computed in a single parallel pass over the triangles. Every
+thread accumulates into its own reducer over a contiguous range of triangles, and reducers are
+merged in thread order at the end.
+\code
+MeshStatistics statistics(mesh, 20); // 20 bins for the aspect histogram
+std::cout << statistics << std::endl; // Quality report
+\endcode
+*/
+
+// Partial statistics of a range of triangles
+class alignas(64) MeshStatisticsReducer
+{
+public:
+  Vector a = Vector(Math::Infinity), b = Vector(-Math::Infinity); //!< Box.
+  double area = 0.0, volume = 0.0;                                //!< Area and six times the volume.
+  double emin = Math::Infinity, emax = 0.0, esum = 0.0, esquare = 0.0; //!< Edge lengths.
+  double amin = 1.0, asum = 0.0;                                  //!< Aspect ratios.
+  int degenerate = 0;                                             //!< Degenerate triangles.
+  std::vector<int> histogram;                                     //!< Histogram of aspect ratios.
+};
+
+/*!
+\brief Compute the statistics of a mesh.
+\param mesh The mesh.
+\param bins Number of bins of the histogram of aspect ratios, at least one.
+*/
+MeshStatistics::MeshStatistics(const Mesh& mesh, int bins) :triangles(mesh.Triangles()), histogram(bins, 0)
+{
+  if (triangles == 0)
+    return;
+
+  const Vector* v = mesh.Vertices().data();
+  const int* index = mesh.VertexIndexes().data();
+
+  // Origin of the signed volumes of the tetrahedra, close to the mesh for precision
+  const Vector o = v[index[0]];
+
+  const int threads = triangles < Parallel::Grain / 4 ? 1 : Parallel::Threads();
+  std::vector<MeshStatisticsReducer> reducers(threads);
+  int used = 1;
+
+#pragma omp parallel num_threads(threads)
+  {
+    int t = 0;
+    int nt = 1;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+#pragma omp single
+    used = nt;
+
+    const int begin = int((long long)(triangles) * t / nt);
+    const int end = int((long long)(triangles) * (t + 1) / nt);
+
+    MeshStatisticsReducer& r = reducers[t];
+    r.histogram.assign(bins, 0);
+
+    for (int i = begin; i < end; i++)
+    {
+      const Vector p = v[index[3 * i]];
+      const Vector q = v[index[3 * i + 1]];
+      const Vector s = v[index[3 * i + 2]];
+
+      r.a = Vector::Min(r.a, Vector::Min(p, Vector::Min(q, s)));
+      r.b = Vector::Max(r.b, Vector::Max(p, Vector::Max(q, s)));
+
+      const double n = Norm((q - p) / (s - p));
+      r.area += n;
+      r.volume += (p - o) * ((q - o) / (s - o));
+
+      // Edges
+      const double ab = Norm(q - p);
+      const double bc = Norm(s - q);
+      const double ca = Norm(p - s);
+      r.emin = Math::Min(r.emin, ab, Math::Min(bc, ca));
+      r.emax = Math::Max(r.emax, ab, Math::Max(bc, ca));
+      r.esum += ab + bc + ca;
+      r.esquare += ab * ab + bc * bc + ca * ca;
+
+      // Aspect ratio, as in Triangle::Aspect() from the edge lengths already computed
+      double aspect = 0.0;
+      if (n == 0.0)
+      {
+        r.degenerate++;
+      }
+      else
+      {
+        const double h = 0.5 * (ab + bc + ca);
+        aspect = Math::Clamp(8.0 * (h - ab) * (h - bc) * (h - ca) / (ab * bc * ca), 0.0, 1.0);
+      }
+      r.amin = Math::Min(r.amin, aspect);
+      r.asum += aspect;
+      const int k = int(aspect * bins);
+      r.histogram[k < bins ? k : bins - 1]++;
+    }
+  }
+
+  // Merge in thread order, so that the result does not depend on scheduling
+  MeshStatisticsReducer& m = reducers[0];
+  for (int t = 1; t < used; t++)
+  {
+    const MeshStatisticsReducer& r = reducers[t];
+    m.a = Vector::Min(m.a, r.a);
+    m.b = Vector::Max(m.b, r.b);
+    m.area += r.area;
+    m.volume += r.volume;
+    m.emin = Math::Min(m.emin, r.emin);
+    m.emax = Math::Max(m.emax, r.emax);
+    m.esum += r.esum;
+    m.esquare += r.esquare;
+    m.amin = Math::Min(m.amin, r.amin);
+    m.asum += r.asum;
+    m.degenerate += r.degenerate;
+    for (int k = 0; k < bins; k++)
+    {
+      m.histogram[k] += r.histogram[k];
+    }
+  }
+
+  box = Box(m.a, m.b);
+  area = 0.5 * m.area;
+  volume = m.volume / 6.0;
+  emin = m.emin;
+  emax = m.emax;
+  esum = m.esum;
+  esquare = m.esquare;
+  amin = m.amin;
+  asum = m.asum;
+  degenerate = m.degenerate;
+  histogram = std::move(m.histogram);
+}
+
+//! Get the standard deviation of edge lengths.
+double MeshStatistics::EdgeDeviation() const
+{
+  if (triangles == 0)
+    return 0.0;
+  const double mean = AverageEdge();
+  return sqrt(Math::Max(esquare / Edges() - mean * mean, 0.0));
+}
+
+/*!
+\brief Overloaded, writes a quality report.
+\param s Stream.
+\param statistics Statistics.
+*/
+std::ostream& operator<<(std::ostream& s, const MeshStatistics& statistics)
+{
+  s << "Triangles: " << statistics.triangles << " (" << statistics.degenerate << " degenerate)" << std::endl;
+  s << "Box: " << statistics.box << std::endl;
+  s << "Area: " << statistics.area << std::endl;
+  s << "Volume: " << statistics.volume << std::endl;
+  s << "Edges: min " << statistics.emin << ", max " << statistics.emax << ", average " << statistics.AverageEdge() << ", deviation " << statistics.EdgeDeviation() << std::endl;
+  s << "Aspect: min " << statistics.amin << ", average " << statistics.AverageAspect() << std::endl;
+
+  const int bins = int(statistics.histogram.size());
+  for (int k = 0; k < bins; k++)
+  {
+    s << "  [" << double(k) / bins << ", " << double(k + 1) / bins << "[ " << statistics.histogram[k] << std::endl;
+  }
+  return s;
+}
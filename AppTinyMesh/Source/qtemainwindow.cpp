@@ -73,7 +73,9 @@ void MainWindow::SphereImplicitExample()
   for (size_t i = 0; i < cols.size(); i++)
     cols[i] = Color(0.8, 0.8, 0.8);
 
-  meshColor = MeshColor(implicitMesh, cols, implicitMesh.VertexIndexes());
+  // Colors are indexed like the vertices, the arrays of the mesh are moved rather than copied
+  std::vector<int> carray = implicitMesh.VertexIndexes();
+  meshColor = MeshColor(std::move(implicitMesh), std::move(cols), std::move(carray));
   UpdateGeometry();
 }
 
@@ -0,0 +1,310 @@
+// Ray cast renderer
+
+#include "renderer.h"
+
+#include <QtCore/QFile>
+#include <QtCore/qstring.h>
+
+/*!
+\class Renderer renderer.h
+\brief Multithreaded ray cast renderer of meshes, which does not need any graphics hardware.
+
+The image is split into square tiles of pixels rendered in parallel, and the camera rays of
+every tile are traced through the hierarchies of the meshes by packets of 8&times;8 rays, see
+MeshBVH::Intersect(const Ray*, int, MeshBVHHit*, double) const. Shading follows the shader
+mesh.glsl of the viewer, with normal or color materials.
+\code
+Renderer renderer;
+renderer.AddMesh(mesh);
+std::vector<Color> image;
+renderer.Render(Camera(Vector(-3.0, -2.0, 1.5), Vector::Null), 512, 512, image);
+Renderer::Save("preview.png", image, 512, 512);
+\endcode
+*/
+
+/*!
+\brief Add a mesh, which is copied.
+\param mesh The mesh, which is white if shaded with a color material.
+\param material Material, shading by normals by default.
+*/
+void Renderer::AddMesh(const Mesh& mesh, RendererMaterial material)
+{
+  AddMesh(MeshColor(mesh), material);
+}
+
+/*!
+\brief Add a mesh with colors, which is copied.
+\param mesh The mesh.
+\param material Material, shading by colors by default.
+*/
+void Renderer::AddMesh(const MeshColor& mesh, RendererMaterial material)
+{
+  meshes.push_back(mesh);
+  hierarchies.push_back(MeshBVH(mesh));
+  materials.push_back(material);
+}
+
+/*!
+\brief Render an image.
+
+Pixels are stored row after row, starting from the top of the image.
+\param camera The camera.
+\param w, h Size of the image.
+\param image Colors of the pixels.
+*/
+void Renderer::Render(const Camera& camera, int w, int h, std::vector<Color>& image) const
+{
+  image.assign(size_t(w) * h, background);
+  if (meshes.empty())
+    return;
+
+  const Vector view = Normalized(camera.View());
+  const int tx = (w + TileSize - 1) / TileSize;
+  const int ty = (h + TileSize - 1) / TileSize;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int k = 0; k < tx * ty; k++)
+  {
+    const int x0 = (k % tx) * TileSize, x1 = x0 + TileSize < w ? x0 + TileSize : w;
+    const int y0 = (k / tx) * TileSize, y1 = y0 + TileSize < h ? y0 + TileSize : h;
+
+    // Packets of 8x8 pixels
+    for (int py = y0; py < y1; py += 8)
+    {
+      for (int px = x0; px < x1; px += 8)
+      {
+        Ray rays[MeshBVH::PacketSize];
+        int pixel[MeshBVH::PacketSize];
+        int n = 0;
+        for (int y = py; y < py + 8 && y < y1; y++)
+        {
+          for (int x = px; x < px + 8 && x < x1; x++)
+          {
+            rays[n] = camera.PixelToRay(x, y, w, h);
+            pixel[n++] = y * w + x;
+          }
+        }
+
+        // Closest intersection with all the meshes
+        MeshBVHHit closest[MeshBVH::PacketSize], hits[MeshBVH::PacketSize];
+        int object[MeshBVH::PacketSize];
+        for (int i = 0; i < n; i++)
+        {
+          object[i] = -1;
+        }
+        for (int m = 0; m < int(meshes.size()); m++)
+        {
+          if (hierarchies[m].Intersect(rays, n, hits) == 0)
+            continue;
+          for (int i = 0; i < n; i++)
+          {
+            if (hits[i].IsHit() && hits[i].t < closest[i].t)
+            {
+              closest[i] = hits[i];
+              object[i] = m;
+            }
+          }
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+          if (object[i] != -1)
+          {
+            image[pixel[i]] = Shade(object[i], closest[i], view);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+\brief Compute the color of an intersection, as the shader mesh.glsl.
+
+Normals and colors are interpolated over the triangle. The normal material maps the normal to
+a color, and the color material applies a diffuse lighting from the viewer.
+\param m Mesh.
+\param hit Intersection with the mesh.
+\param view Viewing direction.
+*/
+Color Renderer::Shade(int m, const MeshBVHHit& hit, const Vector& view) const
+{
+  const MeshColor& mesh = meshes[m];
+  const int t = hit.index;
+  const double w = 1.0 - hit.u - hit.v;
+
+  Vector n;
+  const std::vector<int>& na = mesh.NormalIndexes();
+  if (na.size() == mesh.VertexIndexes().size() && !mesh.Normals().empty())
+  {
+    n = w * mesh.Normal(na[3 * t]) + hit.u * mesh.Normal(na[3 * t + 1]) + hit.v * mesh.Normal(na[3 * t + 2]);
+  }
+  else
+  {
+    n = mesh.GetTriangle(t).Normal();
+  }
+  n = Normalized(n);
+
+  if (materials[m] == RendererMaterial::Normal)
+  {
+    return Color(0.2 * (3.0 + 2.0 * n[0]), 0.2 * (3.0 + 2.0 * n[1]), 0.2 * (3.0 + 2.0 * n[2]));
+  }
+
+  const std::vector<int>& ca = mesh.ColorIndexes();
+  const Color c = w * mesh.GetColor(ca[3 * t]) + hit.u * mesh.GetColor(ca[3 * t + 1]) + hit.v * mesh.GetColor(ca[3 * t + 2]);
+
+  // Modified diffuse lighting
+  const double d = 0.5 * (1.0 - n * view);
+  const Color s = c * Math::Clamp(0.25 + d * d);
+  return Color(s[0], s[1], s[2]);
+}
+
+/*!
+\brief Save an image, in PPM format if the name of the file ends with .ppm, and in PNG format otherwise.
+\param name Name of the file.
+\param image Colors of the pixels, row after row from the top.
+\param w, h Size of the image.
+*/
+bool Renderer::Save(const QString& name, const std::vector<Color>& image, int w, int h)
+{
+  if (name.endsWith(".ppm", Qt::CaseInsensitive))
+    return SavePPM(name, image, w, h);
+  return SavePNG(name, image, w, h);
+}
+
+/*!
+\brief Convert the pixels of an image to bytes, three per pixel.
+\param image Colors of the pixels.
+\param bytes Red, green and blue components.
+*/
+static void RendererBytes(const std::vector<Color>& image, std::vector<unsigned char>& bytes)
+{
+  bytes.resize(3 * image.size());
+#pragma omp parallel for schedule(static) if(image.size() >= (1 << 16))
+  for (int i = 0; i < int(image.size()); i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      bytes[3 * size_t(i) + k] = (unsigned char)(255.0 * Math::Clamp(image[i][k]) + 0.5);
+    }
+  }
+}
+
+/*!
+\brief Save an image in binary PPM format.
+\param name Name of the file.
+\param image Colors of the pixels, row after row from the top.
+\param w, h Size of the image.
+*/
+bool Renderer::SavePPM(const QString& name, const std::vector<Color>& image, int w, int h)
+{
+  QFile data(name);
+  if (!data.open(QFile::WriteOnly))
+    return false;
+
+  const std::string header = "P6\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n";
+  std::vector<unsigned char> bytes;
+  RendererBytes(image, bytes);
+  const bool ok = data.write(header.data(), header.size()) == qint64(header.size()) && data.write((const char*)bytes.data(), bytes.size()) == qint64(bytes.size());
+  data.close();
+  return ok;
+}
+
+/*!
+\brief Append a chunk to a PNG stream, with its length and checksum.
+\param png Stream.
+\param type Type of the chunk.
+\param data Data of the chunk.
+*/
+static void RendererChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data)
+{
+  static unsigned int table[256];
+  static const bool init = []()
+    {
+      for (unsigned int n = 0; n < 256; n++)
+      {
+        unsigned int c = n;
+        for (int k = 0; k < 8; k++)
+        {
+          c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+      }
+      return true;
+    }();
+  (void)init;
+
+  const unsigned int n = (unsigned int)(data.size());
+  const unsigned char length[4] = { (unsigned char)(n >> 24), (unsigned char)(n >> 16), (unsigned char)(n >> 8), (unsigned char)(n) };
+  png.insert(png.end(), length, length + 4);
+  const size_t start = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+
+  // Checksum of the type and the data
+  unsigned int crc = 0xffffffffu;
+  for (size_t i = start; i < png.size(); i++)
+  {
+    crc = table[(crc ^ png[i]) & 0xff] ^ (crc >> 8);
+  }
+  crc ^= 0xffffffffu;
+  const unsigned char sum[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)(crc) };
+  png.insert(png.end(), sum, sum + 4);
+}
+
+/*!
+\brief Save an image in PNG format.
+
+The image data is stored in uncompressed deflate blocks, so that no compression library is needed.
+\param name Name of the file.
+\param image Colors of the pixels, row after row from the top.
+\param w, h Size of the image.
+*/
+bool Renderer::SavePNG(const QString& name, const std::vector<Color>& image, int w, int h)
+{
+  QFile data(name);
+  if (!data.open(QFile::WriteOnly))
+    return false;
+
+  std::vector<unsigned char> bytes;
+  RendererBytes(image, bytes);
+
+  // Scanlines, each one preceded by a null filter type
+  std::vector<unsigned char> raw;
+  raw.reserve(size_t(3 * w + 1) * h);
+  for (int y = 0; y < h; y++)
+  {
+    raw.push_back(0);
+    raw.insert(raw.end(), bytes.begin() + size_t(3) * w * y, bytes.begin() + size_t(3) * w * (y + 1));
+  }
+
+  // Zlib stream of stored blocks
+  std::vector<unsigned char> z = { 0x78, 0x01 };
+  for (size_t i = 0; i < raw.size() || i == 0; i += 65535)
+  {
+    const size_t n = raw.size() - i < 65535 ? raw.size() - i : 65535;
+    const unsigned char header[5] = { (unsigned char)(i + n == raw.size() ? 1 : 0), (unsigned char)(n), (unsigned char)(n >> 8), (unsigned char)(~n), (unsigned char)(~n >> 8) };
+    z.insert(z.end(), header, header + 5);
+    z.insert(z.end(), raw.begin() + i, raw.begin() + i + n);
+  }
+  unsigned int a = 1, b = 0;
+  for (size_t i = 0; i < raw.size(); i++)
+  {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  const unsigned int adler = (b << 16) | a;
+  const unsigned char sum[4] = { (unsigned char)(adler >> 24), (unsigned char)(adler >> 16), (unsigned char)(adler >> 8), (unsigned char)(adler) };
+  z.insert(z.end(), sum, sum + 4);
+
+  // Header with 8 bit RGB pixels, data and end
+  std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  const std::vector<unsigned char> ihdr = { (unsigned char)(w >> 24), (unsigned char)(w >> 16), (unsigned char)(w >> 8), (unsigned char)(w),
+    (unsigned char)(h >> 24), (unsigned char)(h >> 16), (unsigned char)(h >> 8), (unsigned char)(h), 8, 2, 0, 0, 0 };
+  RendererChunk(png, "IHDR", ihdr);
+  RendererChunk(png, "IDAT", z);
+  RendererChunk(png, "IEND", std::vector<unsigned char>());
+
+  const bool ok = data.write((const char*)png.data(), png.size()) == qint64(png.size());
+  data.close();
+  return ok;
+}
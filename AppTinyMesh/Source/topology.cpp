@@ -0,0 +1,209 @@
+// Topology
+
+#include "topology.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <climits>
+#include <memory>
+
+/*!
+\class MeshTopology topology.h
+\brief Half-edge adjacency of a triangle mesh, stored as a compact corner table.
+
+Half-edges are implicit: half-edge h=3*t+i of triangle t goes from vertex i to vertex (i+1)%3
+of the triangle, so the next and previous half-edges are computed and the structure only
+stores, for every half-edge, its twin and the index of its undirected edge, and for every
+vertex one outgoing half-edge. This provides constant time traversal of the one-ring:
+
+\code
+const MeshTopology& topology = mesh.Topology();
+int h = topology.Outgoing(v);
+do
+{
+  int w = mesh.VertexIndex(MeshTopology::Face(h), MeshTopology::Next(h) % 3); // Neighbor of v
+  h = topology.Swing(h);
+} while (h >= 0 && h != topology.Outgoing(v));
+\endcode
+
+Edges shared by a single triangle are boundary edges, edges shared by more than two triangles
+or by two triangles with inconsistent orientations are non-manifold edges.
+\sa Mesh::Topology()
+*/
+
+/*!
+\brief Atomically replace a value by the minimum of itself and another value.
+\param a Atomic value.
+\param x Value.
+*/
+static void AtomicMin(std::atomic<int>& a, int x)
+{
+  int y = a.load(std::memory_order_relaxed);
+  while (x < y && !a.compare_exchange_weak(y, x, std::memory_order_relaxed))
+  {
+  }
+}
+
+/*!
+\brief Build the topology of a triangle mesh.
+
+Directed edges are keyed by their sorted end vertices and sorted in parallel with a radix sort,
+so that the half-edges of an undirected edge are consecutive. Runs of one half-edge are
+boundary edges, runs of two opposite half-edges are twins, and longer runs are non-manifold.
+\param varray Vertex indexes, three per triangle.
+\param nv Number of vertices.
+*/
+MeshTopology::MeshTopology(const std::vector<int>& varray, int nv)
+{
+  const int nh = int(varray.size());
+
+  twin.resize(nh);
+  edge.resize(nh);
+  outgoing.resize(nv);
+  flags.resize(nv);
+
+  // Sort half-edges by undirected edge
+  std::vector<unsigned long long> keys(nh);
+  std::vector<int> order(nh);
+
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < nh; h++)
+  {
+    unsigned long long a = (unsigned int)(varray[h]);
+    unsigned long long b = (unsigned int)(varray[Next(h)]);
+    keys[h] = a < b ? (a << 32) | b : (b << 32) | a;
+    order[h] = h;
+  }
+
+  Parallel::RadixSort(keys, order);
+
+  // Undirected edge indexes from the heads of the runs
+  std::vector<int> id(nh);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nh; i++)
+  {
+    id[i] = (i == 0 || keys[i] != keys[i - 1]) ? 1 : 0;
+  }
+  edges = Parallel::ExclusiveScan(id);
+
+  int nb = 0;
+  int nm = 0;
+#pragma omp parallel for schedule(static) reduction(+:nb,nm)
+  for (int i = 0; i < nh; i++)
+  {
+    if (i != 0 && keys[i] == keys[i - 1])
+      continue;
+
+    int j = i + 1;
+    while (j < nh && keys[j] == keys[i])
+    {
+      j++;
+    }
+
+    for (int k = i; k < j; k++)
+    {
+      edge[order[k]] = id[i];
+    }
+
+    if (j - i == 1)
+    {
+      twin[order[i]] = Boundary;
+      nb++;
+    }
+    else if (j - i == 2 && varray[order[i]] != varray[order[i + 1]])
+    {
+      twin[order[i]] = order[i + 1];
+      twin[order[i + 1]] = order[i];
+    }
+    else
+    {
+      for (int k = i; k < j; k++)
+      {
+        twin[order[k]] = NonManifold;
+      }
+      nm++;
+    }
+  }
+  boundary = nb;
+  nonmanifold = nm;
+
+  // Free memory before vertex pass
+  keys = std::vector<unsigned long long>();
+  order = std::vector<int>();
+  id = std::vector<int>();
+
+  // Corners, first half-edge of the fans and flags of the vertices
+  std::unique_ptr<std::atomic<int>[]> count(new std::atomic<int>[nv]);
+  std::unique_ptr<std::atomic<int>[]> first(new std::atomic<int>[nv]);
+  std::unique_ptr<std::atomic<int>[]> start(new std::atomic<int>[nv]);
+  std::unique_ptr<std::atomic<int>[]> bits(new std::atomic<int>[nv]);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < nv; i++)
+  {
+    count[i].store(0, std::memory_order_relaxed);
+    first[i].store(INT_MAX, std::memory_order_relaxed);
+    start[i].store(INT_MAX, std::memory_order_relaxed);
+    bits[i].store(0, std::memory_order_relaxed);
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < nh; h++)
+  {
+    const int v = varray[h];
+    count[v].fetch_add(1, std::memory_order_relaxed);
+    AtomicMin(first[v], h);
+
+    // Outgoing and incoming edges of the vertex in the triangle
+    const int a = twin[h];
+    const int b = twin[Prev(h)];
+    if (b < 0)
+    {
+      AtomicMin(start[v], h);
+    }
+    if (a == Boundary || b == Boundary)
+    {
+      bits[v].fetch_or(BoundaryVertex, std::memory_order_relaxed);
+    }
+    if (a == NonManifold || b == NonManifold)
+    {
+      bits[v].fetch_or(NonManifoldVertex, std::memory_order_relaxed);
+    }
+  }
+
+  // Check that the triangles of every vertex form a single fan
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < nv; v++)
+  {
+    const int n = count[v].load(std::memory_order_relaxed);
+    int s = start[v].load(std::memory_order_relaxed);
+    if (s == INT_MAX)
+    {
+      s = first[v].load(std::memory_order_relaxed);
+    }
+    int f = bits[v].load(std::memory_order_relaxed);
+
+    if (n == 0)
+    {
+      outgoing[v] = -1;
+    }
+    else
+    {
+      outgoing[v] = s;
+
+      int c = 0;
+      int h = s;
+      do
+      {
+        c++;
+        h = Swing(h);
+      } while (h >= 0 && h != s && c <= n);
+
+      if (c != n)
+      {
+        f |= NonManifoldVertex;
+      }
+    }
+    flags[v] = char(f);
+  }
+}
@@ -2,6 +2,10 @@
 
 #include "mesh.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
 double Triangle::epsilon = 1.0e-7;
 
 /*!
@@ -96,6 +100,78 @@ bool Triangle::Intersect(const Ray& ray, double& t, double& u, double& v) const
   return true;
 }
 
+/*!
+\brief Compute the closest point of the triangle to a point.
+
+The point is classified against the Voronoi regions of the vertices, the edges and the interior of
+the triangle with dot products, see Ericson, <i>Real-Time Collision Detection</i>, 2005. Coordinates
+are exactly null or one when the closest point is a vertex.
+\param q The point.
+\param u,v Returned parametric coordinates of the closest point, see Triangle::Vertex().
+*/
+Vector Triangle::Closest(const Vector& q, double& u, double& v) const
+{
+  const Vector ab = p[1] - p[0];
+  const Vector ac = p[2] - p[0];
+
+  // Vertex regions and edge regions of the first vertex
+  const Vector ap = q - p[0];
+  const double d1 = ab * ap;
+  const double d2 = ac * ap;
+  if (d1 <= 0.0 && d2 <= 0.0)
+  {
+    u = v = 0.0;
+    return p[0];
+  }
+  const Vector bp = q - p[1];
+  const double d3 = ab * bp;
+  const double d4 = ac * bp;
+  if (d3 >= 0.0 && d4 <= d3)
+  {
+    u = 1.0;
+    v = 0.0;
+    return p[1];
+  }
+  const double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+  {
+    u = d1 / (d1 - d3);
+    v = 0.0;
+    return p[0] + u * ab;
+  }
+  const Vector cp = q - p[2];
+  const double d5 = ab * cp;
+  const double d6 = ac * cp;
+  if (d6 >= 0.0 && d5 <= d6)
+  {
+    u = 0.0;
+    v = 1.0;
+    return p[2];
+  }
+  const double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+  {
+    u = 0.0;
+    v = d2 / (d2 - d6);
+    return p[0] + v * ac;
+  }
+
+  // Opposite edge
+  const double va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+  {
+    v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    u = 1.0 - v;
+    return p[1] + v * (p[2] - p[1]);
+  }
+
+  // Interior
+  const double s = 1.0 / (va + vb + vc);
+  u = vb * s;
+  v = vc * s;
+  return p[0] + u * ab + v * ac;
+}
+
 /*!
 \brief Translates a triangle by a given vector.
 
@@ -179,3 +255,220 @@ std::ostream& operator<<(std::ostream& s, const Triangle& t)
   s << "Triangle(" << t.p[0] << ',' << t.p[1] << ',' << t.p[2] << ')';
   return s;
 }
+
+/*!
+\class TriangleBlockF mesh.h
+\brief A block of triangles stored in single precision as structure of arrays, for testing one ray against several triangles at once.
+
+The block is tested in a single pass of eight lanes with AVX, which is also used on AVX-512 hardware,
+and lane after lane otherwise. Edges are computed in registers from the vertices, so that the same
+vertices are shared by adjacent triangles, which the watertight mode requires.
+\code
+TriangleBlockF block;
+block.Gather(mesh.Vertices(), mesh.VertexIndexes(), 0, 8);
+RayF r(ray);
+float t, u, v;
+int l = block.Intersect(r, 1e30f, t, u, v); // Closest triangle, or -1
+\endcode
+*/
+
+/*!
+\brief Intersect a ray with one triangle with the watertight algorithm [Woop et al. 2013].
+
+The vertices are given in the frame of the ray, sheared in single precision so that the direction
+of the ray is the dominant axis. Edge functions of the projected triangle are evaluated in double
+precision, where the products of single precision coordinates are exact, so that edges shared by
+adjacent triangles yield exactly opposite edge functions whatever the contraction of the floating
+point operations, and no ray passes between them.
+\param x, y, z Coordinates of the vertices in the frame of the ray.
+\param tmax Maximum distance.
+\param t Intersection depth.
+\param u, v Parametric coordinates of the intersection.
+*/
+bool TriangleBlockF::Watertight(const float* x, const float* y, const float* z, float tmax, float& t, float& u, float& v)
+{
+  // Edge functions, i.e. barycentric coordinates scaled by the determinant
+  const double e0 = double(x[2]) * double(y[1]) - double(y[2]) * double(x[1]);
+  const double e1 = double(x[0]) * double(y[2]) - double(y[0]) * double(x[2]);
+  const double e2 = double(x[1]) * double(y[0]) - double(y[1]) * double(x[0]);
+  if ((e0 < 0.0 || e1 < 0.0 || e2 < 0.0) && (e0 > 0.0 || e1 > 0.0 || e2 > 0.0))
+    return false;
+  const double det = e0 + e1 + e2;
+  if (det == 0.0)
+    return false;
+
+  const double d = (e0 * z[0] + e1 * z[1] + e2 * z[2]) / det;
+  if (!(d > 0.0 && d < tmax))
+    return false;
+  t = float(d);
+  u = float(e1 / det);
+  v = float(e2 / det);
+  return true;
+}
+
+/*!
+\brief Compute the closest intersection between a ray and the triangles of the block.
+
+The Moller-Trumbore algorithm is used by default. The watertight mode is slower, as the
+edge functions are evaluated in double precision, but never misses intersections on the edges
+and vertices shared by adjacent triangles.
+\param ray The ray.
+\param tmax Maximum distance.
+\param t Intersection depth.
+\param u, v Parametric coordinates of the intersection in the triangle.
+\param watertight Watertight mode.
+\return The lane of the closest triangle, or -1 if no triangle is hit between 0 and tmax.
+*/
+int TriangleBlockF::Intersect(const RayF& ray, float tmax, float& t, float& u, float& v, bool watertight) const
+{
+  alignas(32) float tt[Width], uu[Width], vv[Width];
+  int mask = 0;
+  if (watertight)
+  {
+#if defined(__AVX__)
+    // Vertices in the frame of the ray
+    const __m256 ox = _mm256_set1_ps(ray.o[ray.kx]), oy = _mm256_set1_ps(ray.o[ray.ky]), oz = _mm256_set1_ps(ray.o[ray.kz]);
+    const __m256 sx = _mm256_set1_ps(ray.s[0]), sy = _mm256_set1_ps(ray.s[1]), sz = _mm256_set1_ps(ray.s[2]);
+    __m256 x[3], y[3], z[3];
+    for (int i = 0; i < 3; i++)
+    {
+      const __m256 pz = _mm256_sub_ps(_mm256_load_ps(c[i][ray.kz]), oz);
+      x[i] = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(c[i][ray.kx]), ox), _mm256_mul_ps(sx, pz));
+      y[i] = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(c[i][ray.ky]), oy), _mm256_mul_ps(sy, pz));
+      z[i] = _mm256_mul_ps(sz, pz);
+    }
+
+    // Edge functions in double precision, four lanes at a time
+    alignas(32) double dd[Width], da[Width], db[Width];
+    for (int h = 0; h < 2; h++)
+    {
+      __m256d xd[3], yd[3], zd[3];
+      for (int i = 0; i < 3; i++)
+      {
+        xd[i] = _mm256_cvtps_pd(h == 0 ? _mm256_castps256_ps128(x[i]) : _mm256_extractf128_ps(x[i], 1));
+        yd[i] = _mm256_cvtps_pd(h == 0 ? _mm256_castps256_ps128(y[i]) : _mm256_extractf128_ps(y[i], 1));
+        zd[i] = _mm256_cvtps_pd(h == 0 ? _mm256_castps256_ps128(z[i]) : _mm256_extractf128_ps(z[i], 1));
+      }
+      const __m256d e0 = _mm256_sub_pd(_mm256_mul_pd(xd[2], yd[1]), _mm256_mul_pd(yd[2], xd[1]));
+      const __m256d e1 = _mm256_sub_pd(_mm256_mul_pd(xd[0], yd[2]), _mm256_mul_pd(yd[0], xd[2]));
+      const __m256d e2 = _mm256_sub_pd(_mm256_mul_pd(xd[1], yd[0]), _mm256_mul_pd(yd[1], xd[0]));
+
+      const __m256d zero = _mm256_setzero_pd();
+      const __m256d negative = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(e0, zero, _CMP_LT_OQ), _mm256_cmp_pd(e1, zero, _CMP_LT_OQ)), _mm256_cmp_pd(e2, zero, _CMP_LT_OQ));
+      const __m256d positive = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(e0, zero, _CMP_GT_OQ), _mm256_cmp_pd(e1, zero, _CMP_GT_OQ)), _mm256_cmp_pd(e2, zero, _CMP_GT_OQ));
+      const __m256d det = _mm256_add_pd(_mm256_add_pd(e0, e1), e2);
+      const __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0), det);
+      const __m256d d = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e0, zd[0]), _mm256_mul_pd(e1, zd[1])), _mm256_mul_pd(e2, zd[2])), inv);
+
+      // Null determinants yield undefined depths, which fail the comparisons
+      __m256d hit = _mm256_andnot_pd(_mm256_and_pd(negative, positive), _mm256_cmp_pd(d, zero, _CMP_GT_OQ));
+      hit = _mm256_and_pd(hit, _mm256_cmp_pd(d, _mm256_set1_pd(tmax), _CMP_LT_OQ));
+      mask |= _mm256_movemask_pd(hit) << (4 * h);
+      _mm256_store_pd(dd + 4 * h, d);
+      _mm256_store_pd(da + 4 * h, _mm256_mul_pd(e1, inv));
+      _mm256_store_pd(db + 4 * h, _mm256_mul_pd(e2, inv));
+    }
+    for (int l = 0; l < Width; l++)
+    {
+      tt[l] = float(dd[l]);
+      uu[l] = float(da[l]);
+      vv[l] = float(db[l]);
+    }
+#else
+    for (int l = 0; l < n; l++)
+    {
+      float x[3], y[3], z[3];
+      for (int i = 0; i < 3; i++)
+      {
+        const float pz = c[i][ray.kz][l] - ray.o[ray.kz];
+        x[i] = (c[i][ray.kx][l] - ray.o[ray.kx]) - ray.s[0] * pz;
+        y[i] = (c[i][ray.ky][l] - ray.o[ray.ky]) - ray.s[1] * pz;
+        z[i] = ray.s[2] * pz;
+      }
+      if (Watertight(x, y, z, tmax, tt[l], uu[l], vv[l]))
+      {
+        mask |= 1 << l;
+      }
+    }
+#endif
+  }
+  else
+  {
+#if defined(__AVX__)
+    const __m256 dx = _mm256_set1_ps(ray.d[0]), dy = _mm256_set1_ps(ray.d[1]), dz = _mm256_set1_ps(ray.d[2]);
+    const __m256 px = _mm256_load_ps(c[0][0]), py = _mm256_load_ps(c[0][1]), pz = _mm256_load_ps(c[0][2]);
+    const __m256 e1x = _mm256_sub_ps(_mm256_load_ps(c[1][0]), px);
+    const __m256 e1y = _mm256_sub_ps(_mm256_load_ps(c[1][1]), py);
+    const __m256 e1z = _mm256_sub_ps(_mm256_load_ps(c[1][2]), pz);
+    const __m256 e2x = _mm256_sub_ps(_mm256_load_ps(c[2][0]), px);
+    const __m256 e2y = _mm256_sub_ps(_mm256_load_ps(c[2][1]), py);
+    const __m256 e2z = _mm256_sub_ps(_mm256_load_ps(c[2][2]), pz);
+
+    // Cross product of the direction and the second edge
+    const __m256 sx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    const __m256 sy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    const __m256 sz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, sx), _mm256_mul_ps(e1y, sy)), _mm256_mul_ps(e1z, sz));
+    const __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    const __m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray.o[0]), px);
+    const __m256 ty = _mm256_sub_ps(_mm256_set1_ps(ray.o[1]), py);
+    const __m256 tz = _mm256_sub_ps(_mm256_set1_ps(ray.o[2]), pz);
+    const __m256 a = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, sx), _mm256_mul_ps(ty, sy)), _mm256_mul_ps(tz, sz)), inv);
+
+    // Cross product of the origin relative to the first vertex and the first edge
+    const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+    const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+    const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+    const __m256 b = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv);
+    const __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv);
+
+    // Comparisons with undefined values fail, which discards parallel triangles
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GE_OQ), _mm256_cmp_ps(b, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(a, b), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(d, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+    _mm256_store_ps(tt, d);
+    _mm256_store_ps(uu, a);
+    _mm256_store_ps(vv, b);
+    mask = _mm256_movemask_ps(hit);
+#else
+    for (int l = 0; l < n; l++)
+    {
+      const float p[3] = { c[0][0][l], c[0][1][l], c[0][2][l] };
+      const float e1[3] = { c[1][0][l] - p[0], c[1][1][l] - p[1], c[1][2][l] - p[2] };
+      const float e2[3] = { c[2][0][l] - p[0], c[2][1][l] - p[1], c[2][2][l] - p[2] };
+      const float s[3] = { ray.d[1] * e2[2] - ray.d[2] * e2[1], ray.d[2] * e2[0] - ray.d[0] * e2[2], ray.d[0] * e2[1] - ray.d[1] * e2[0] };
+      const float inv = 1.0f / (e1[0] * s[0] + e1[1] * s[1] + e1[2] * s[2]);
+      const float r[3] = { ray.o[0] - p[0], ray.o[1] - p[1], ray.o[2] - p[2] };
+      const float q[3] = { r[1] * e1[2] - r[2] * e1[1], r[2] * e1[0] - r[0] * e1[2], r[0] * e1[1] - r[1] * e1[0] };
+      uu[l] = (r[0] * s[0] + r[1] * s[1] + r[2] * s[2]) * inv;
+      vv[l] = (ray.d[0] * q[0] + ray.d[1] * q[1] + ray.d[2] * q[2]) * inv;
+      tt[l] = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+      if (uu[l] >= 0.0f && vv[l] >= 0.0f && uu[l] + vv[l] <= 1.0f && tt[l] > 0.0f && tt[l] < tmax)
+      {
+        mask |= 1 << l;
+      }
+    }
+#endif
+  }
+  mask &= (1 << n) - 1;
+
+  // Closest lane
+  int lane = -1;
+  for (int l = 0; l < n; l++)
+  {
+    if ((mask & (1 << l)) && (lane == -1 || tt[l] < tt[lane]))
+    {
+      lane = l;
+    }
+  }
+  if (lane != -1)
+  {
+    t = tt[lane];
+    u = uu[lane];
+    v = vv[lane];
+  }
+  return lane;
+}
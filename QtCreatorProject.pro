@@ -12,29 +12,54 @@ VPATH += AppTinyMesh
 
 SOURCES += \
     AppTinyMesh/Source/box.cpp \
+    AppTinyMesh/Source/distancegrid.cpp \
     AppTinyMesh/Source/evector.cpp \
+    AppTinyMesh/Source/frame.cpp \
     AppTinyMesh/Source/implicits.cpp \
     AppTinyMesh/Source/main.cpp \
     AppTinyMesh/Source/camera.cpp \
+    AppTinyMesh/Source/mesh-cache.cpp \
+    AppTinyMesh/Source/mesh-decimate.cpp \
+    AppTinyMesh/Source/mesh-smooth.cpp \
+    AppTinyMesh/Source/mesh-sort.cpp \
+    AppTinyMesh/Source/mesh-subdivide.cpp \
+    AppTinyMesh/Source/mesh-transform.cpp \
+    AppTinyMesh/Source/mesh-weld.cpp \
     AppTinyMesh/Source/mesh.cpp \
+    AppTinyMesh/Source/meshbvh.cpp \
     AppTinyMesh/Source/meshcolor.cpp \
     AppTinyMesh/Source/mesh-widget.cpp \
+    AppTinyMesh/Source/meshcompressed.cpp \
+    AppTinyMesh/Source/meshdistance.cpp \
+    AppTinyMesh/Source/meshf.cpp \
+    AppTinyMesh/Source/meshstatistics.cpp \
     AppTinyMesh/Source/qtemainwindow.cpp \
     AppTinyMesh/Source/ray.cpp \
+    AppTinyMesh/Source/renderer.cpp \
     AppTinyMesh/Source/shader-api.cpp \
+    AppTinyMesh/Source/topology.cpp \
     AppTinyMesh/Source/triangle.cpp \
 
 HEADERS += \
     AppTinyMesh/Include/box.h \
     AppTinyMesh/Include/camera.h \
     AppTinyMesh/Include/color.h \
+    AppTinyMesh/Include/distancegrid.h \
     AppTinyMesh/Include/implicits.h \
     AppTinyMesh/Include/mathematics.h \
     AppTinyMesh/Include/mesh.h \
+    AppTinyMesh/Include/meshbvh.h \
     AppTinyMesh/Include/meshcolor.h \
+    AppTinyMesh/Include/meshcompressed.h \
+    AppTinyMesh/Include/meshdistance.h \
+    AppTinyMesh/Include/meshf.h \
+    AppTinyMesh/Include/meshstatistics.h \
+    AppTinyMesh/Include/parallel.h \
     AppTinyMesh/Include/qte.h \
     AppTinyMesh/Include/realtime.h \
+    AppTinyMesh/Include/renderer.h \
     AppTinyMesh/Include/shader-api.h \
+    AppTinyMesh/Include/topology.h \
 
 FORMS += \
     AppTinyMesh/UI/interface.ui